@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <exception>
+#include <limits>
+#include "doctest.h"
+
+// Heap allocations made through operator new since the program started. Counted by the operator new replacements in
+// TestAllocations.cpp, which must be linked into the test program.
+struct AllocationCount {
+    std::size_t allocations;
+    std::size_t bytes; // Requested bytes, without allocator overhead
+    std::size_t releases; // Blocks freed through operator delete
+};
+
+AllocationCount allocations_so_far();
+
+// Allocations made since construction.
+class AllocationScope {
+public:
+    AllocationScope() : start(allocations_so_far()) {}
+
+    std::size_t allocations() const {
+        return allocations_so_far().allocations - start.allocations;
+    }
+
+    std::size_t bytes() const {
+        return allocations_so_far().bytes - start.bytes;
+    }
+
+    std::ptrdiff_t live() const { // Blocks allocated and not yet freed, negative when older blocks were freed
+        AllocationCount now = allocations_so_far();
+        return std::ptrdiff_t(now.allocations - start.allocations) - std::ptrdiff_t(now.releases - start.releases);
+    }
+
+private:
+    AllocationCount start;
+};
+
+// Fails the enclosing test case if the code between construction and the end of the scope allocates more often, or
+// more bytes, than the budget allows.
+class AllocationBudget : public AllocationScope {
+public:
+    explicit AllocationBudget(std::size_t max_allocations, std::size_t max_bytes = std::numeric_limits<std::size_t>::max())
+        : max_allocations(max_allocations), max_bytes(max_bytes) {}
+
+    ~AllocationBudget() {
+        if (std::uncaught_exceptions() > 0) return; // The test already failed
+        std::size_t used_allocations = allocations(), used_bytes = bytes(); // Before the checks allocate anything
+        CHECK_MESSAGE(used_allocations <= max_allocations, "allocation budget exceeded: " << used_allocations
+                                                           << " allocations, budget " << max_allocations);
+        CHECK_MESSAGE(used_bytes <= max_bytes, "allocation budget exceeded: " << used_bytes << " bytes, budget " << max_bytes);
+    }
+
+private:
+    std::size_t max_allocations;
+    std::size_t max_bytes;
+};
@@ -2,67 +2,105 @@
 
 #include <iostream>
 #include <cmath>
+#include <type_traits>
 
-class Complex {
+template <typename F>
+class BasicComplex {
 public:
-    Complex(double real = 0.0, double imag = 0.0) : real(real), imag(imag) {}
+    typedef F value_type; // Precision of the real and imaginary parts
 
-    double getReal() const { return real; }
-    double getImag() const { return imag; }
+    constexpr BasicComplex(F real = 0, F imag = 0) noexcept : real(real), imag(imag) {}
 
-    double magnitude() const {
-        return std::sqrt(real * real + imag * imag);
+    constexpr F getReal() const noexcept { return real; }
+    constexpr F getImag() const noexcept { return imag; }
+
+    F magnitude() const noexcept {
+        return std::sqrt(norm());
+    }
+
+    constexpr F norm() const noexcept { // Squared magnitude, orders values like magnitude() without the sqrt
+        return real * real + imag * imag;
+    }
+
+    constexpr BasicComplex conj() const noexcept {
+        return BasicComplex(real, -imag);
+    }
+
+    constexpr BasicComplex operator+(const BasicComplex& other) const noexcept {
+        return BasicComplex(real + other.real, imag + other.imag);
     }
 
-    Complex operator+(const Complex& other) const {
-        return Complex(real + other.real, imag + other.imag);
+    constexpr BasicComplex operator-(const BasicComplex& other) const noexcept {
+        return BasicComplex(real - other.real, imag - other.imag);
     }
 
-    Complex operator-(const Complex& other) const {
-        return Complex(real - other.real, imag - other.imag);
+    constexpr BasicComplex operator*(const BasicComplex& other) const noexcept {
+        return BasicComplex(real * other.real - imag * other.imag, real * other.imag + imag * other.real);
     }
 
-    Complex operator*(const Complex& other) const {
-        return Complex(real * other.real - imag * other.imag, real * other.imag + imag * other.real);
+    constexpr BasicComplex operator/(const BasicComplex& other) const noexcept {
+        return multiply_conjugate(other).scaled_down(other.norm());
     }
 
-    Complex operator/(const Complex& other) const {
-        double denominator = other.real * other.real + other.imag * other.imag;
-        return Complex((real * other.real + imag * other.imag) / denominator,
-                       (imag * other.real - real * other.imag) / denominator);
+    constexpr BasicComplex multiply_add(const BasicComplex& factor, const BasicComplex& addend) const noexcept {
+        // *this * factor + addend without the intermediate value
+        return BasicComplex(real * factor.real - imag * factor.imag + addend.real,
+                            real * factor.imag + imag * factor.real + addend.imag);
     }
 
-    bool operator==(const Complex& other) const {
+    constexpr BasicComplex multiply_conjugate(const BasicComplex& other) const noexcept { // *this * other.conj()
+        return BasicComplex(real * other.real + imag * other.imag, imag * other.real - real * other.imag);
+    }
+
+    constexpr BasicComplex reciprocal() const noexcept { // 1 / *this
+        return conj().scaled_down(norm());
+    }
+
+    constexpr bool operator==(const BasicComplex& other) const noexcept {
         return real == other.real && imag == other.imag;
     }
 
-    bool operator!=(const Complex& other) const {
+    constexpr bool operator!=(const BasicComplex& other) const noexcept {
         return !(*this == other);
     }
 
-    bool operator<(const Complex& other) const {
-        return magnitude() < other.magnitude();
+    constexpr bool operator<(const BasicComplex& other) const noexcept {
+        return norm() < other.norm();
     }
 
-    bool operator<=(const Complex& other) const {
-        return magnitude() <= other.magnitude();
+    constexpr bool operator<=(const BasicComplex& other) const noexcept {
+        return norm() <= other.norm();
     }
 
-    bool operator>(const Complex& other) const {
-        return magnitude() > other.magnitude();
+    constexpr bool operator>(const BasicComplex& other) const noexcept {
+        return norm() > other.norm();
     }
 
-    bool operator>=(const Complex& other) const {
-        return magnitude() >= other.magnitude();
+    constexpr bool operator>=(const BasicComplex& other) const noexcept {
+        return norm() >= other.norm();
     }
 
-    friend std::ostream& operator<<(std::ostream& os, const Complex& complex) {
+    friend std::ostream& operator<<(std::ostream& os, const BasicComplex& complex) {
         os << complex.real << " + " << complex.imag << "i";
         return os;
     }
 
 private:
-    double real;
-    double imag;
+    F real;
+    F imag;
+
+    constexpr BasicComplex scaled_down(F divisor) const noexcept {
+        return BasicComplex(real / divisor, imag / divisor);
+    }
 };
 
+typedef BasicComplex<double> Complex; // Double precision, 16 bytes per value
+typedef BasicComplex<float> ComplexF; // Single precision, 8 bytes per value
+
+static_assert(std::is_trivially_copyable<Complex>::value && std::is_trivially_copyable<ComplexF>::value,
+              "Complex must stay trivially copyable");
+
+template <typename F>
+constexpr F order_key(const BasicComplex<F>& value) noexcept { // Key used by Tree::myHeap, found by argument-dependent lookup
+    return value.norm();
+}
@@ -0,0 +1,357 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "Complex.hpp"
+#include "Tree.hpp"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define COMPLEX_ARRAY_X86 1
+#include <immintrin.h>
+#endif
+
+enum class SimdLevel { Scalar, SSE2, AVX2 }; // Instruction sets the ComplexArray kernels can use
+
+#ifdef COMPLEX_ARRAY_X86
+// Thin wrappers giving the kernels one interface for both precisions, LANES values fit in a register. They are always
+// inlined into kernels compiled for the same instruction set, so vector types never cross a function boundary.
+template <typename F> struct Sse2Ops;
+template <typename F> struct Avx2Ops;
+
+template <> struct Sse2Ops<double> {
+    typedef __m128d V;
+    enum { LANES = 2 };
+    __attribute__((target("sse2"), always_inline)) static inline V load(const double* p) { return _mm_loadu_pd(p); }
+    __attribute__((target("sse2"), always_inline)) static inline void store(double* p, V v) { _mm_storeu_pd(p, v); }
+    __attribute__((target("sse2"), always_inline)) static inline V add(V a, V b) { return _mm_add_pd(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V sub(V a, V b) { return _mm_sub_pd(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V mul(V a, V b) { return _mm_mul_pd(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V div(V a, V b) { return _mm_div_pd(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V sqrt(V a) { return _mm_sqrt_pd(a); }
+    __attribute__((target("sse2"), always_inline)) static inline int less_mask(V a, V b) { return _mm_movemask_pd(_mm_cmplt_pd(a, b)); }
+};
+
+template <> struct Sse2Ops<float> {
+    typedef __m128 V;
+    enum { LANES = 4 };
+    __attribute__((target("sse2"), always_inline)) static inline V load(const float* p) { return _mm_loadu_ps(p); }
+    __attribute__((target("sse2"), always_inline)) static inline void store(float* p, V v) { _mm_storeu_ps(p, v); }
+    __attribute__((target("sse2"), always_inline)) static inline V add(V a, V b) { return _mm_add_ps(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V sub(V a, V b) { return _mm_sub_ps(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V mul(V a, V b) { return _mm_mul_ps(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V div(V a, V b) { return _mm_div_ps(a, b); }
+    __attribute__((target("sse2"), always_inline)) static inline V sqrt(V a) { return _mm_sqrt_ps(a); }
+    __attribute__((target("sse2"), always_inline)) static inline int less_mask(V a, V b) { return _mm_movemask_ps(_mm_cmplt_ps(a, b)); }
+};
+
+template <> struct Avx2Ops<double> {
+    typedef __m256d V;
+    enum { LANES = 4 };
+    __attribute__((target("avx2"), always_inline)) static inline V load(const double* p) { return _mm256_loadu_pd(p); }
+    __attribute__((target("avx2"), always_inline)) static inline void store(double* p, V v) { _mm256_storeu_pd(p, v); }
+    __attribute__((target("avx2"), always_inline)) static inline V add(V a, V b) { return _mm256_add_pd(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V sub(V a, V b) { return _mm256_sub_pd(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V mul(V a, V b) { return _mm256_mul_pd(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V div(V a, V b) { return _mm256_div_pd(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V sqrt(V a) { return _mm256_sqrt_pd(a); }
+    __attribute__((target("avx2"), always_inline)) static inline int less_mask(V a, V b) { return _mm256_movemask_pd(_mm256_cmp_pd(a, b, _CMP_LT_OQ)); }
+};
+
+template <> struct Avx2Ops<float> {
+    typedef __m256 V;
+    enum { LANES = 8 };
+    __attribute__((target("avx2"), always_inline)) static inline V load(const float* p) { return _mm256_loadu_ps(p); }
+    __attribute__((target("avx2"), always_inline)) static inline void store(float* p, V v) { _mm256_storeu_ps(p, v); }
+    __attribute__((target("avx2"), always_inline)) static inline V add(V a, V b) { return _mm256_add_ps(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V sub(V a, V b) { return _mm256_sub_ps(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V mul(V a, V b) { return _mm256_mul_ps(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V div(V a, V b) { return _mm256_div_ps(a, b); }
+    __attribute__((target("avx2"), always_inline)) static inline V sqrt(V a) { return _mm256_sqrt_ps(a); }
+    __attribute__((target("avx2"), always_inline)) static inline int less_mask(V a, V b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+};
+#endif
+
+// Complex numbers stored as separate arrays of real and imaginary parts (structure of arrays), so that bulk
+// arithmetic runs several values per instruction. The kernel is chosen once at runtime from the CPU features.
+template <typename F>
+class BasicComplexArray {
+public:
+    typedef BasicComplex<F> value_type;
+
+    BasicComplexArray() {}
+    explicit BasicComplexArray(std::size_t count) : re(count), im(count) {}
+
+    std::size_t size() const { return re.size(); }
+    bool empty() const { return re.empty(); }
+
+    void reserve(std::size_t count) {
+        re.reserve(count);
+        im.reserve(count);
+    }
+
+    void resize(std::size_t count) {
+        re.resize(count);
+        im.resize(count);
+    }
+
+    void clear() {
+        re.clear();
+        im.clear();
+    }
+
+    void push_back(const value_type& value) {
+        re.push_back(value.getReal());
+        im.push_back(value.getImag());
+    }
+
+    value_type operator[](std::size_t i) const {
+        return value_type(re[i], im[i]);
+    }
+
+    void set(std::size_t i, const value_type& value) {
+        re[i] = value.getReal();
+        im[i] = value.getImag();
+    }
+
+    const F* real() const { return re.data(); }
+    const F* imag() const { return im.data(); }
+    F* real() { return re.data(); }
+    F* imag() { return im.data(); }
+
+    template <int K>
+    void gather(const Tree<value_type, K>& tree, Order order = Order::DFS) { // Copies the tree values in DFS or BFS order
+        clear();
+        if (order == Order::BFS) {
+            for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) push_back((*it)->get_value());
+        } else {
+            for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) push_back((*it)->get_value());
+        }
+    }
+
+    template <int K>
+    void scatter(Tree<value_type, K>& tree, Order order = Order::DFS) const { // Writes values back in the gather order
+        tree.rewrite_values(order, [this](std::size_t i, value_type& value) {
+            if (i < size()) value = (*this)[i];
+        });
+    }
+
+    static SimdLevel supported_simd() { // Best instruction set of this CPU
+#ifdef COMPLEX_ARRAY_X86
+        static const SimdLevel level = __builtin_cpu_supports("avx2") ? SimdLevel::AVX2
+                                     : __builtin_cpu_supports("sse2") ? SimdLevel::SSE2 : SimdLevel::Scalar;
+        return level;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    static SimdLevel active_simd() {
+        return active_level();
+    }
+
+    static void force_simd(SimdLevel level) { // Restricts the kernels, e.g. to compare them; capped at supported_simd()
+        active_level() = level > supported_simd() ? supported_simd() : level;
+    }
+
+    static void add(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out) {
+        check_sizes(a, b, out);
+        std::size_t n = a.size(), i = 0;
+#ifdef COMPLEX_ARRAY_X86
+        if (active_simd() == SimdLevel::AVX2) i = add_avx2(a, b, out, n);
+        else if (active_simd() == SimdLevel::SSE2) i = add_sse2(a, b, out, n);
+#endif
+        for (; i < n; ++i) {
+            out.re[i] = a.re[i] + b.re[i];
+            out.im[i] = a.im[i] + b.im[i];
+        }
+    }
+
+    static void subtract(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out) {
+        check_sizes(a, b, out);
+        std::size_t n = a.size(), i = 0;
+#ifdef COMPLEX_ARRAY_X86
+        if (active_simd() == SimdLevel::AVX2) i = subtract_avx2(a, b, out, n);
+        else if (active_simd() == SimdLevel::SSE2) i = subtract_sse2(a, b, out, n);
+#endif
+        for (; i < n; ++i) {
+            out.re[i] = a.re[i] - b.re[i];
+            out.im[i] = a.im[i] - b.im[i];
+        }
+    }
+
+    static void multiply(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out) {
+        check_sizes(a, b, out);
+        std::size_t n = a.size(), i = 0;
+#ifdef COMPLEX_ARRAY_X86
+        if (active_simd() == SimdLevel::AVX2) i = multiply_avx2(a, b, out, n);
+        else if (active_simd() == SimdLevel::SSE2) i = multiply_sse2(a, b, out, n);
+#endif
+        for (; i < n; ++i) {
+            F r = a.re[i] * b.re[i] - a.im[i] * b.im[i];
+            out.im[i] = a.re[i] * b.im[i] + a.im[i] * b.re[i];
+            out.re[i] = r;
+        }
+    }
+
+    static void divide(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out) {
+        check_sizes(a, b, out);
+        std::size_t n = a.size(), i = 0;
+#ifdef COMPLEX_ARRAY_X86
+        if (active_simd() == SimdLevel::AVX2) i = divide_avx2(a, b, out, n);
+        else if (active_simd() == SimdLevel::SSE2) i = divide_sse2(a, b, out, n);
+#endif
+        for (; i < n; ++i) {
+            F denominator = b.re[i] * b.re[i] + b.im[i] * b.im[i];
+            F r = (a.re[i] * b.re[i] + a.im[i] * b.im[i]) / denominator;
+            out.im[i] = (a.im[i] * b.re[i] - a.re[i] * b.im[i]) / denominator;
+            out.re[i] = r;
+        }
+    }
+
+    static void magnitude(const BasicComplexArray& a, std::vector<F>& out) {
+        out.resize(a.size());
+        std::size_t n = a.size(), i = 0;
+#ifdef COMPLEX_ARRAY_X86
+        if (active_simd() == SimdLevel::AVX2) i = magnitude_avx2(a, out.data(), n);
+        else if (active_simd() == SimdLevel::SSE2) i = magnitude_sse2(a, out.data(), n);
+#endif
+        for (; i < n; ++i) {
+            out[i] = std::sqrt(a.re[i] * a.re[i] + a.im[i] * a.im[i]);
+        }
+    }
+
+    static void less_magnitude(const BasicComplexArray& a, const BasicComplexArray& b, std::vector<unsigned char>& out) {
+        // out[i] = |a[i]| < |b[i]|, compared on squared magnitudes like BasicComplex::operator<
+        if (a.size() != b.size()) {
+            throw std::invalid_argument("ComplexArray sizes do not match");
+        }
+        out.resize(a.size());
+        std::size_t n = a.size(), i = 0;
+#ifdef COMPLEX_ARRAY_X86
+        if (active_simd() == SimdLevel::AVX2) i = less_magnitude_avx2(a, b, out.data(), n);
+        else if (active_simd() == SimdLevel::SSE2) i = less_magnitude_sse2(a, b, out.data(), n);
+#endif
+        for (; i < n; ++i) {
+            out[i] = a.re[i] * a.re[i] + a.im[i] * a.im[i] < b.re[i] * b.re[i] + b.im[i] * b.im[i];
+        }
+    }
+
+    BasicComplexArray operator+(const BasicComplexArray& other) const {
+        BasicComplexArray out(size());
+        add(*this, other, out);
+        return out;
+    }
+
+    BasicComplexArray operator-(const BasicComplexArray& other) const {
+        BasicComplexArray out(size());
+        subtract(*this, other, out);
+        return out;
+    }
+
+    BasicComplexArray operator*(const BasicComplexArray& other) const {
+        BasicComplexArray out(size());
+        multiply(*this, other, out);
+        return out;
+    }
+
+    BasicComplexArray operator/(const BasicComplexArray& other) const {
+        BasicComplexArray out(size());
+        divide(*this, other, out);
+        return out;
+    }
+
+private:
+    std::vector<F> re; // Real parts
+    std::vector<F> im; // Imaginary parts
+
+    static SimdLevel& active_level() {
+        static SimdLevel level = supported_simd();
+        return level;
+    }
+
+    static void check_sizes(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out) {
+        if (a.size() != b.size()) {
+            throw std::invalid_argument("ComplexArray sizes do not match");
+        }
+        out.resize(a.size());
+    }
+
+#ifdef COMPLEX_ARRAY_X86
+    // Each kernel processes whole registers and returns how many values it handled, the caller finishes the tail.
+    // The bodies are written once against Ops and stamped out per instruction set, each inside a function compiled for
+    // that set: a generic template would be compiled without AVX and pass __m256 values through its own calls.
+#define COMPLEX_ARRAY_KERNELS(isa, Ops)                                                                                   \
+    __attribute__((target(#isa))) static std::size_t add_##isa(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out, std::size_t n) { \
+        typedef Ops<F> O;                                                                                                 \
+        std::size_t i = 0;                                                                                                \
+        for (; i + O::LANES <= n; i += O::LANES) {                                                                        \
+            O::store(&out.re[i], O::add(O::load(&a.re[i]), O::load(&b.re[i])));                                           \
+            O::store(&out.im[i], O::add(O::load(&a.im[i]), O::load(&b.im[i])));                                           \
+        }                                                                                                                 \
+        return i;                                                                                                         \
+    }                                                                                                                     \
+    __attribute__((target(#isa))) static std::size_t subtract_##isa(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out, std::size_t n) { \
+        typedef Ops<F> O;                                                                                                 \
+        std::size_t i = 0;                                                                                                \
+        for (; i + O::LANES <= n; i += O::LANES) {                                                                        \
+            O::store(&out.re[i], O::sub(O::load(&a.re[i]), O::load(&b.re[i])));                                           \
+            O::store(&out.im[i], O::sub(O::load(&a.im[i]), O::load(&b.im[i])));                                           \
+        }                                                                                                                 \
+        return i;                                                                                                         \
+    }                                                                                                                     \
+    __attribute__((target(#isa))) static std::size_t multiply_##isa(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out, std::size_t n) { \
+        typedef Ops<F> O;                                                                                                 \
+        std::size_t i = 0;                                                                                                \
+        for (; i + O::LANES <= n; i += O::LANES) {                                                                        \
+            typename O::V ar = O::load(&a.re[i]), ai = O::load(&a.im[i]);                                                 \
+            typename O::V br = O::load(&b.re[i]), bi = O::load(&b.im[i]);                                                 \
+            O::store(&out.re[i], O::sub(O::mul(ar, br), O::mul(ai, bi)));                                                 \
+            O::store(&out.im[i], O::add(O::mul(ar, bi), O::mul(ai, br)));                                                 \
+        }                                                                                                                 \
+        return i;                                                                                                         \
+    }                                                                                                                     \
+    __attribute__((target(#isa))) static std::size_t divide_##isa(const BasicComplexArray& a, const BasicComplexArray& b, BasicComplexArray& out, std::size_t n) { \
+        typedef Ops<F> O;                                                                                                 \
+        std::size_t i = 0;                                                                                                \
+        for (; i + O::LANES <= n; i += O::LANES) {                                                                        \
+            typename O::V ar = O::load(&a.re[i]), ai = O::load(&a.im[i]);                                                 \
+            typename O::V br = O::load(&b.re[i]), bi = O::load(&b.im[i]);                                                 \
+            typename O::V denominator = O::add(O::mul(br, br), O::mul(bi, bi));                                           \
+            O::store(&out.re[i], O::div(O::add(O::mul(ar, br), O::mul(ai, bi)), denominator));                            \
+            O::store(&out.im[i], O::div(O::sub(O::mul(ai, br), O::mul(ar, bi)), denominator));                            \
+        }                                                                                                                 \
+        return i;                                                                                                         \
+    }                                                                                                                     \
+    __attribute__((target(#isa))) static std::size_t magnitude_##isa(const BasicComplexArray& a, F* out, std::size_t n) { \
+        typedef Ops<F> O;                                                                                                 \
+        std::size_t i = 0;                                                                                                \
+        for (; i + O::LANES <= n; i += O::LANES) {                                                                        \
+            typename O::V ar = O::load(&a.re[i]), ai = O::load(&a.im[i]);                                                 \
+            O::store(out + i, O::sqrt(O::add(O::mul(ar, ar), O::mul(ai, ai))));                                           \
+        }                                                                                                                 \
+        return i;                                                                                                         \
+    }                                                                                                                     \
+    __attribute__((target(#isa))) static std::size_t less_magnitude_##isa(const BasicComplexArray& a, const BasicComplexArray& b, unsigned char* out, std::size_t n) { \
+        typedef Ops<F> O;                                                                                                 \
+        std::size_t i = 0;                                                                                                \
+        for (; i + O::LANES <= n; i += O::LANES) {                                                                        \
+            typename O::V ar = O::load(&a.re[i]), ai = O::load(&a.im[i]);                                                 \
+            typename O::V br = O::load(&b.re[i]), bi = O::load(&b.im[i]);                                                 \
+            int mask = O::less_mask(O::add(O::mul(ar, ar), O::mul(ai, ai)), O::add(O::mul(br, br), O::mul(bi, bi)));       \
+            for (int lane = 0; lane < O::LANES; ++lane) {                                                                 \
+                out[i + lane] = (mask >> lane) & 1;                                                                       \
+            }                                                                                                             \
+        }                                                                                                                 \
+        return i;                                                                                                         \
+    }
+
+    COMPLEX_ARRAY_KERNELS(sse2, Sse2Ops)
+    COMPLEX_ARRAY_KERNELS(avx2, Avx2Ops)
+#undef COMPLEX_ARRAY_KERNELS
+#endif
+};
+
+typedef BasicComplexArray<double> ComplexArray;
+typedef BasicComplexArray<float> ComplexArrayF; // Twice as many values per register as ComplexArray
@@ -0,0 +1,215 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+#include "Complex.hpp"
+#include "Node.hpp"
+#include "Tree.hpp"
+
+// Square region of the complex plane held by one quadtree node. Leaves keep their points in a bucket, every cell
+// keeps the number and sum of the points below it so summaries never have to visit them.
+template <typename F>
+struct QuadCell {
+    BasicComplex<F> center;
+    F half; // Half of the side length
+    std::size_t count; // Points in this cell and below
+    BasicComplex<F> sum; // Sum of those points, sum / count is their centroid
+    std::vector<BasicComplex<F>> bucket; // Points of a leaf, empty once the cell is split
+
+    QuadCell(const BasicComplex<F>& center = BasicComplex<F>(), F half = 0) : center(center), half(half), count(0) {}
+
+    bool contains(const BasicComplex<F>& point) const {
+        return point.getReal() >= center.getReal() - half && point.getReal() < center.getReal() + half &&
+               point.getImag() >= center.getImag() - half && point.getImag() < center.getImag() + half;
+    }
+
+    int quadrant(const BasicComplex<F>& point) const { // Child index: bit 0 for the right half, bit 1 for the top half
+        return (point.getReal() >= center.getReal() ? 1 : 0) | (point.getImag() >= center.getImag() ? 2 : 0);
+    }
+
+    BasicComplex<F> child_center(int quadrant) const {
+        F offset = half / 2;
+        return BasicComplex<F>(center.getReal() + (quadrant & 1 ? offset : -offset),
+                               center.getImag() + (quadrant & 2 ? offset : -offset));
+    }
+};
+
+// Region quadtree over complex points, stored in a Tree<QuadCell<F>, 4> whose child i covers quadrant i. Inserts
+// walk one path from the root, updating aggregates on the way, and split a leaf when its bucket overflows.
+template <typename F>
+class BasicComplexQuadTree {
+public:
+    typedef BasicComplex<F> value_type;
+    typedef QuadCell<F> Cell;
+
+    struct Summary { // Aggregate of one cell, used for level-of-detail views
+        value_type center;
+        F half;
+        std::size_t count;
+        value_type centroid;
+    };
+
+    BasicComplexQuadTree(const value_type& center, F half, std::size_t bucket_size = 16, std::size_t max_depth = 32)
+        : bucket_size(bucket_size), max_depth(max_depth) {
+        if (!finite(center) || !(half > 0) || !std::isfinite(half)) { // NaN fails half > 0 too
+            throw std::invalid_argument("Quadtree needs a finite center and a positive finite half side");
+        }
+        tree.emplace_root(center, half);
+    }
+
+    void insert(const value_type& point) { // Growing towards a NaN or infinite point would never reach it
+        if (!finite(point)) {
+            throw std::invalid_argument("Quadtree points must be finite");
+        }
+        while (!tree.get_root()->data.contains(point)) {
+            grow(point);
+        }
+        std::size_t depth = 0;
+        const auto& node = tree.update_path([&point, &depth](Node<Cell>& current) { // Copies cells a snapshot shares
+            Cell& cell = current.data;
+            ++cell.count;
+            cell.sum = cell.sum + point;
+            if (current.children.empty()) return -1;
+            ++depth;
+            return cell.quadrant(point);
+        });
+        Cell& leaf = node->data;
+        leaf.bucket.push_back(point);
+        if (leaf.bucket.size() > bucket_size && depth < max_depth) {
+            split(node, depth);
+        }
+    }
+
+    std::size_t size() const {
+        return tree.get_root()->data.count;
+    }
+
+    std::vector<value_type> query(const value_type& low, const value_type& high) const { // Points in [low, high]
+        std::vector<value_type> result;
+        query(tree.get_root().get(), low, high, result);
+        return result;
+    }
+
+    std::size_t count(const value_type& low, const value_type& high) const { // Same as query().size(), using aggregates
+        return count(tree.get_root().get(), low, high);
+    }
+
+    std::vector<Summary> level_of_detail(std::size_t level) const { // Non-empty cells at depth level, or shallower leaves
+        std::vector<Summary> result;
+        summarise(tree.get_root().get(), level, result);
+        return result;
+    }
+
+    const Tree<Cell, 4>& cells() const { // The underlying tree, e.g. for traversals or snapshots
+        return tree;
+    }
+
+private:
+    Tree<Cell, 4> tree;
+    std::size_t bucket_size; // Points a leaf holds before it is split
+    std::size_t max_depth; // Leaves at this depth are never split, so duplicates cannot recurse forever
+
+    void split(const std::shared_ptr<Node<Cell>>& node, std::size_t depth) { // node is the tree's own link, not a copy
+        Cell& cell = node->data;
+        for (int quadrant = 0; quadrant < 4; ++quadrant) {
+            tree.emplace_child(node, cell.child_center(quadrant), cell.half / 2);
+        }
+        for (const auto& point : cell.bucket) {
+            Cell& child = node->children[cell.quadrant(point)]->data;
+            ++child.count;
+            child.sum = child.sum + point;
+            child.bucket.push_back(point);
+        }
+        cell.bucket.clear();
+        cell.bucket.shrink_to_fit();
+        for (const auto& child : node->children) {
+            if (child->data.bucket.size() > bucket_size && depth + 1 < max_depth) {
+                split(child, depth + 1);
+            }
+        }
+    }
+
+    void grow(const value_type& point) { // Doubles the root towards point, the old root becomes one quadrant
+        auto old_root = tree.detach(tree.get_root());
+        const Cell& old_cell = old_root->data;
+        F half = old_cell.half;
+        value_type center(old_cell.center.getReal() + (point.getReal() >= old_cell.center.getReal() ? half : -half),
+                          old_cell.center.getImag() + (point.getImag() >= old_cell.center.getImag() ? half : -half));
+        Cell cell(center, 2 * half);
+        cell.count = old_cell.count;
+        cell.sum = old_cell.sum;
+        tree.emplace_root(std::move(cell));
+        const auto& root = tree.update_path([](Node<Cell>&) { return -1; }); // The tree's own link, see split()
+        int old_quadrant = root->data.quadrant(old_cell.center);
+        for (int quadrant = 0; quadrant < 4; ++quadrant) {
+            if (quadrant == old_quadrant) {
+                tree.reattach(root, old_root);
+            } else {
+                tree.emplace_child(root, root->data.child_center(quadrant), half);
+            }
+        }
+    }
+
+    static bool finite(const value_type& point) {
+        return std::isfinite(point.getReal()) && std::isfinite(point.getImag());
+    }
+
+    static bool inside(const value_type& point, const value_type& low, const value_type& high) {
+        return point.getReal() >= low.getReal() && point.getReal() <= high.getReal() &&
+               point.getImag() >= low.getImag() && point.getImag() <= high.getImag();
+    }
+
+    static bool disjoint(const Cell& cell, const value_type& low, const value_type& high) {
+        return cell.center.getReal() + cell.half < low.getReal() || cell.center.getReal() - cell.half > high.getReal() ||
+               cell.center.getImag() + cell.half < low.getImag() || cell.center.getImag() - cell.half > high.getImag();
+    }
+
+    static bool covered(const Cell& cell, const value_type& low, const value_type& high) {
+        return cell.center.getReal() - cell.half >= low.getReal() && cell.center.getReal() + cell.half <= high.getReal() &&
+               cell.center.getImag() - cell.half >= low.getImag() && cell.center.getImag() + cell.half <= high.getImag();
+    }
+
+    static void query(const Node<Cell>* node, const value_type& low, const value_type& high, std::vector<value_type>& result) {
+        const Cell& cell = node->data;
+        if (cell.count == 0 || disjoint(cell, low, high)) return;
+        for (const auto& point : cell.bucket) {
+            if (inside(point, low, high)) result.push_back(point);
+        }
+        for (const auto& child : node->children) {
+            query(child.get(), low, high, result);
+        }
+    }
+
+    static std::size_t count(const Node<Cell>* node, const value_type& low, const value_type& high) {
+        const Cell& cell = node->data;
+        if (cell.count == 0 || disjoint(cell, low, high)) return 0;
+        if (covered(cell, low, high)) return cell.count;
+        std::size_t total = 0;
+        for (const auto& point : cell.bucket) {
+            if (inside(point, low, high)) ++total;
+        }
+        for (const auto& child : node->children) {
+            total += count(child.get(), low, high);
+        }
+        return total;
+    }
+
+    static void summarise(const Node<Cell>* node, std::size_t level, std::vector<Summary>& result) {
+        const Cell& cell = node->data;
+        if (cell.count == 0) return;
+        if (level == 0 || node->children.empty()) {
+            F scale = F(1) / F(cell.count);
+            result.push_back(Summary{cell.center, cell.half, cell.count,
+                                     value_type(cell.sum.getReal() * scale, cell.sum.getImag() * scale)});
+            return;
+        }
+        for (const auto& child : node->children) {
+            summarise(child.get(), level - 1, result);
+        }
+    }
+};
+
+typedef BasicComplexQuadTree<double> ComplexQuadTree;
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
+#include <vector>
+#include "Complex.hpp"
+#include "ComplexArray.hpp"
+#include "Node.hpp"
+#include "Tree.hpp"
+
+enum class ExprOp { Constant, Variable, Add, Subtract, Multiply, Divide };
+
+// Node value of an expression tree: operators are interior nodes with two children (left and right operand),
+// constants and variables are leaves.
+template <typename F>
+struct BasicExprToken {
+    ExprOp op;
+    BasicComplex<F> value; // Used by constants
+    std::size_t variable; // Used by variables, index into the bindings
+
+    BasicExprToken(ExprOp op = ExprOp::Constant, const BasicComplex<F>& value = BasicComplex<F>(), std::size_t variable = 0)
+        : op(op), value(value), variable(variable) {}
+
+    static BasicExprToken constant(const BasicComplex<F>& value) { return BasicExprToken(ExprOp::Constant, value); }
+    static BasicExprToken input(std::size_t variable) { return BasicExprToken(ExprOp::Variable, BasicComplex<F>(), variable); }
+
+    bool operator==(const BasicExprToken& other) const {
+        return op == other.op && value == other.value && variable == other.variable;
+    }
+};
+
+typedef BasicExprToken<double> ExprToken;
+
+// Expression tree compiled once into postfix bytecode for a stack machine. evaluate() runs it over whole batches of
+// variable bindings, one ComplexArray kernel per instruction, instead of walking the tree for every evaluation.
+template <typename F>
+class BasicExpression {
+public:
+    typedef BasicComplex<F> Value;
+    typedef BasicComplexArray<F> Batch;
+
+    template <int K>
+    explicit BasicExpression(const Tree<BasicExprToken<F>, K>& tree) : variables(0), depth(0) { // Compiles the tree
+        std::vector<bool> folded; // Whether each stack slot is a constant known at compile time
+        for (auto it = tree.begin_post_order(); it != tree.end_post_order(); ++it) {
+            const BasicExprToken<F>& token = (*it)->get_value();
+            bool leaf = token.op == ExprOp::Constant || token.op == ExprOp::Variable;
+            if ((*it)->children.size() != (leaf ? 0u : 2u)) {
+                throw std::runtime_error("Operators need two operands and leaves no children");
+            }
+            if (token.op == ExprOp::Constant) {
+                code.push_back(Instruction(ExprOp::Constant, 0));
+                constants.push_back(token.value);
+                folded.push_back(true);
+            } else if (token.op == ExprOp::Variable) {
+                code.push_back(Instruction(ExprOp::Variable, token.variable));
+                variables = std::max(variables, token.variable + 1);
+                folded.push_back(false);
+            } else if (folded[folded.size() - 1] && folded[folded.size() - 2]) { // Fold constant operands now
+                Value right = constants.back();
+                constants.pop_back();
+                code.pop_back();
+                constants.back() = apply(token.op, constants.back(), right);
+                folded.pop_back();
+            } else {
+                code.push_back(Instruction(token.op, 0));
+                folded.pop_back();
+                folded.back() = false;
+            }
+            depth = std::max(depth, folded.size());
+        }
+        if (folded.size() != 1) {
+            throw std::runtime_error("Expression tree is empty");
+        }
+    }
+
+    std::size_t variable_count() const { // Bindings needed by evaluate()
+        return variables;
+    }
+
+    std::size_t instruction_count() const {
+        return code.size();
+    }
+
+    Value evaluate(const std::vector<Value>& binding) const { // Single evaluation
+        check_binding_count(binding.size());
+        std::vector<Value> stack;
+        stack.reserve(depth);
+        std::size_t next_constant = 0;
+        for (const auto& instruction : code) {
+            if (instruction.op == ExprOp::Constant) {
+                stack.push_back(constants[next_constant++]);
+            } else if (instruction.op == ExprOp::Variable) {
+                stack.push_back(binding[instruction.operand]);
+            } else {
+                Value right = stack.back();
+                stack.pop_back();
+                stack.back() = apply(instruction.op, stack.back(), right);
+            }
+        }
+        return stack.back();
+    }
+
+    void evaluate(const std::vector<Batch>& bindings, Batch& out) const { // out[i] uses bindings[v][i] for variable v
+        check_binding_count(bindings.size());
+        std::size_t count = bindings.empty() ? 1 : bindings[0].size();
+        for (const auto& binding : bindings) {
+            if (binding.size() != count) {
+                throw std::invalid_argument("Bindings must all have the same size");
+            }
+        }
+        out.resize(count);
+
+        std::vector<Batch> stack(depth, Batch(CHUNK)); // Chunk-sized registers stay in cache
+        for (std::size_t start = 0; start < count; start += CHUNK) {
+            std::size_t n = std::min<std::size_t>(CHUNK, count - start);
+            std::size_t top = 0, next_constant = 0;
+            for (const auto& instruction : code) {
+                if (instruction.op == ExprOp::Constant) {
+                    Batch& target = stack[top++];
+                    target.resize(n);
+                    std::fill(target.real(), target.real() + n, constants[next_constant].getReal());
+                    std::fill(target.imag(), target.imag() + n, constants[next_constant].getImag());
+                    ++next_constant;
+                } else if (instruction.op == ExprOp::Variable) {
+                    Batch& target = stack[top++];
+                    const Batch& source = bindings[instruction.operand];
+                    target.resize(n);
+                    std::copy(source.real() + start, source.real() + start + n, target.real());
+                    std::copy(source.imag() + start, source.imag() + start + n, target.imag());
+                } else {
+                    --top;
+                    apply(instruction.op, stack[top - 1], stack[top], stack[top - 1]); // Kernels allow out == a
+                }
+            }
+            std::copy(stack[0].real(), stack[0].real() + n, out.real() + start);
+            std::copy(stack[0].imag(), stack[0].imag() + n, out.imag() + start);
+        }
+    }
+
+    template <int K>
+    static Value walk(const Tree<BasicExprToken<F>, K>& tree, const std::vector<Value>& binding) { // Evaluates without compiling
+        std::vector<Value> stack;
+        for (auto it = tree.begin_post_order(); it != tree.end_post_order(); ++it) {
+            const BasicExprToken<F>& token = (*it)->get_value();
+            if (token.op == ExprOp::Constant) {
+                stack.push_back(token.value);
+            } else if (token.op == ExprOp::Variable) {
+                stack.push_back(binding.at(token.variable));
+            } else {
+                Value right = stack.back();
+                stack.pop_back();
+                stack.back() = apply(token.op, stack.back(), right);
+            }
+        }
+        return stack.back();
+    }
+
+private:
+    enum { CHUNK = 1024 }; // Evaluations processed per pass over the bytecode
+
+    struct Instruction {
+        ExprOp op;
+        std::size_t operand; // Variable index, unused by other instructions
+        Instruction(ExprOp op, std::size_t operand) : op(op), operand(operand) {}
+    };
+
+    std::vector<Instruction> code; // Postfix order
+    std::vector<Value> constants; // In the order the Constant instructions use them
+    std::size_t variables;
+    std::size_t depth; // Stack slots needed
+
+    void check_binding_count(std::size_t count) const {
+        if (count < variables) {
+            throw std::invalid_argument("Not enough variable bindings");
+        }
+    }
+
+    static Value apply(ExprOp op, const Value& left, const Value& right) {
+        switch (op) {
+            case ExprOp::Add: return left + right;
+            case ExprOp::Subtract: return left - right;
+            case ExprOp::Multiply: return left * right;
+            default: return left / right;
+        }
+    }
+
+    static void apply(ExprOp op, const Batch& left, const Batch& right, Batch& out) {
+        switch (op) {
+            case ExprOp::Add: Batch::add(left, right, out); break;
+            case ExprOp::Subtract: Batch::subtract(left, right, out); break;
+            case ExprOp::Multiply: Batch::multiply(left, right, out); break;
+            default: Batch::divide(left, right, out); break;
+        }
+    }
+};
+
+typedef BasicExpression<double> Expression;
+typedef BasicExpression<float> ExpressionF;
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <vector>
+#include "TreeDump.hpp"
+
+// What one frame of the viewer cost. Renderers add their share with collect(), the viewer fills in frame_ms.
+struct FrameSample {
+    double frame_ms = 0; // From the start of drawing to the end of display()
+    double layout_ms = 0; // Layout work done since the previous frame
+    double bake_ms = 0; // Rebuilding vertex batches for this frame
+    std::size_t draw_calls = 0;
+    std::size_t vertices = 0; // Vertices submitted
+    std::size_t nodes_drawn = 0;
+    std::size_t nodes_collapsed = 0; // Drawn as part of a collapsed subtree
+    std::size_t nodes_culled = 0; // Outside the view
+};
+
+// Rolling frame-time percentiles over the last window frames, and an optional per-frame log that can be written out
+// as CSV for offline analysis.
+class FrameStats {
+public:
+    explicit FrameStats(std::size_t window = 240) : window(std::max<std::size_t>(window, 1)), next(0), frames(0), logging(false) {}
+
+    void record(const FrameSample& sample) {
+        if (recent.size() < window) {
+            recent.push_back(sample);
+        } else {
+            recent[next] = sample;
+        }
+        next = (next + 1) % window;
+        ++frames;
+        if (logging) log.push_back(sample);
+    }
+
+    double percentile(double p) const { // Nearest-rank percentile of frame_ms over the window, 0 when empty
+        if (recent.empty()) return 0;
+        scratch.clear();
+        for (const auto& sample : recent) scratch.push_back(sample.frame_ms);
+        std::size_t rank = std::size_t(std::ceil(p / 100 * scratch.size()));
+        rank = std::min(std::max<std::size_t>(rank, 1), scratch.size()) - 1;
+        std::nth_element(scratch.begin(), scratch.begin() + rank, scratch.end());
+        return scratch[rank];
+    }
+
+    const FrameSample& last() const { // The most recent sample, only valid after the first record()
+        return recent[(next + window - 1) % window];
+    }
+
+    std::size_t frame_count() const { // Frames recorded since construction
+        return frames;
+    }
+
+    void start_log() { // Starts a fresh per-frame log
+        log.clear();
+        logging = true;
+    }
+
+    void stop_log() {
+        logging = false;
+    }
+
+    bool logging_enabled() const {
+        return logging;
+    }
+
+    std::size_t log_size() const {
+        return log.size();
+    }
+
+    void write_csv(std::ostream& os) const { // One header line, then one line per logged frame
+        TextBuffer out(6);
+        out.append("frame,frame_ms,layout_ms,bake_ms,draw_calls,vertices,nodes_drawn,nodes_collapsed,nodes_culled\n");
+        for (std::size_t i = 0; i < log.size(); ++i) {
+            const FrameSample& sample = log[i];
+            out.append(i);
+            out.append(',');
+            out.append(sample.frame_ms);
+            out.append(',');
+            out.append(sample.layout_ms);
+            out.append(',');
+            out.append(sample.bake_ms);
+            out.append(',');
+            out.append(sample.draw_calls);
+            out.append(',');
+            out.append(sample.vertices);
+            out.append(',');
+            out.append(sample.nodes_drawn);
+            out.append(',');
+            out.append(sample.nodes_collapsed);
+            out.append(',');
+            out.append(sample.nodes_culled);
+            out.append('\n');
+        }
+        out.write_to(os);
+    }
+
+private:
+    std::size_t window; // Frames the percentiles cover
+    std::vector<FrameSample> recent; // Ring buffer of the last window frames
+    std::size_t next; // Ring slot the next sample goes to
+    std::size_t frames;
+    bool logging;
+    std::vector<FrameSample> log;
+    mutable std::vector<double> scratch; // Reused by percentile()
+};
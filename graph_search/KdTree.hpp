@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "Complex.hpp"
+#include "Node.hpp"
+#include "Tree.hpp"
+
+// 2-d tree over complex numbers seen as points (real, imag), stored flat: the median of each range is its root,
+// the left half and right half are its subtrees, and the split axis alternates with depth. No child pointers.
+template <typename F>
+class BasicKdTree {
+public:
+    typedef BasicComplex<F> value_type;
+
+    struct Entry {
+        value_type point;
+        std::size_t index; // Position of the point in the input
+    };
+
+    explicit BasicKdTree(const std::vector<value_type>& points) { // O(n log n) bulk build
+        entries.reserve(points.size());
+        for (std::size_t i = 0; i < points.size(); ++i) {
+            entries.push_back(Entry{points[i], i});
+        }
+        build(0, entries.size(), 0);
+    }
+
+    template <int K>
+    explicit BasicKdTree(const Tree<value_type, K>& tree) { // Indexes the tree values, index is the BFS position
+        for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+            entries.push_back(Entry{(*it)->get_value(), entries.size()});
+        }
+        build(0, entries.size(), 0);
+    }
+
+    std::size_t size() const {
+        return entries.size();
+    }
+
+    std::vector<Entry> nearest(const value_type& query, std::size_t k) const { // k nearest points, closest first
+        std::priority_queue<std::pair<F, std::size_t>> best; // Max-heap on squared distance
+        if (k > 0) nearest(0, entries.size(), 0, query, k, best);
+        std::vector<Entry> result(best.size());
+        for (std::size_t i = result.size(); i > 0; --i) {
+            result[i - 1] = entries[best.top().second];
+            best.pop();
+        }
+        return result;
+    }
+
+    std::vector<Entry> in_box(const value_type& low, const value_type& high) const { // low <= point <= high per axis
+        std::vector<Entry> result;
+        in_box(0, entries.size(), 0, low, high, result);
+        return result;
+    }
+
+    std::vector<Entry> in_radius(const value_type& center, F radius) const { // |point - center| <= radius
+        std::vector<Entry> result;
+        in_radius(0, entries.size(), 0, center, radius * radius, result);
+        return result;
+    }
+
+private:
+    std::vector<Entry> entries; // Implicit tree in median order
+
+    static F coordinate(const value_type& point, int axis) {
+        return axis == 0 ? point.getReal() : point.getImag();
+    }
+
+    void build(std::size_t lo, std::size_t hi, int axis) {
+        if (hi - lo <= 1) return;
+        std::size_t mid = lo + (hi - lo) / 2;
+        std::nth_element(entries.begin() + lo, entries.begin() + mid, entries.begin() + hi,
+                         [axis](const Entry& a, const Entry& b) { return coordinate(a.point, axis) < coordinate(b.point, axis); });
+        build(lo, mid, 1 - axis);
+        build(mid + 1, hi, 1 - axis);
+    }
+
+    void nearest(std::size_t lo, std::size_t hi, int axis, const value_type& query, std::size_t k,
+                 std::priority_queue<std::pair<F, std::size_t>>& best) const {
+        if (lo >= hi) return;
+        std::size_t mid = lo + (hi - lo) / 2;
+        F distance = (entries[mid].point - query).norm();
+        if (best.size() < k) {
+            best.push(std::make_pair(distance, mid));
+        } else if (distance < best.top().first) {
+            best.pop();
+            best.push(std::make_pair(distance, mid));
+        }
+        F offset = coordinate(query, axis) - coordinate(entries[mid].point, axis);
+        bool left_first = offset < 0;
+        if (left_first) nearest(lo, mid, 1 - axis, query, k, best); else nearest(mid + 1, hi, 1 - axis, query, k, best);
+        if (best.size() < k || offset * offset < best.top().first) { // The far side may still hold a closer point
+            if (left_first) nearest(mid + 1, hi, 1 - axis, query, k, best); else nearest(lo, mid, 1 - axis, query, k, best);
+        }
+    }
+
+    void in_box(std::size_t lo, std::size_t hi, int axis, const value_type& low, const value_type& high,
+                std::vector<Entry>& result) const {
+        if (lo >= hi) return;
+        std::size_t mid = lo + (hi - lo) / 2;
+        const value_type& point = entries[mid].point;
+        if (point.getReal() >= low.getReal() && point.getReal() <= high.getReal() &&
+            point.getImag() >= low.getImag() && point.getImag() <= high.getImag()) {
+            result.push_back(entries[mid]);
+        }
+        F split = coordinate(point, axis);
+        if (coordinate(low, axis) <= split) in_box(lo, mid, 1 - axis, low, high, result);
+        if (coordinate(high, axis) >= split) in_box(mid + 1, hi, 1 - axis, low, high, result);
+    }
+
+    void in_radius(std::size_t lo, std::size_t hi, int axis, const value_type& center, F radius_squared,
+                   std::vector<Entry>& result) const {
+        if (lo >= hi) return;
+        std::size_t mid = lo + (hi - lo) / 2;
+        if ((entries[mid].point - center).norm() <= radius_squared) {
+            result.push_back(entries[mid]);
+        }
+        F offset = coordinate(center, axis) - coordinate(entries[mid].point, axis);
+        bool reaches_other_side = offset * offset <= radius_squared;
+        if (offset <= 0 || reaches_other_side) in_radius(lo, mid, 1 - axis, center, radius_squared, result);
+        if (offset >= 0 || reaches_other_side) in_radius(mid + 1, hi, 1 - axis, center, radius_squared, result);
+    }
+};
+
+typedef BasicKdTree<double> KdTree;
+typedef BasicKdTree<float> KdTreeF;
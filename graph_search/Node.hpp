@@ -1,6 +1,9 @@
 #pragma once
 #include <vector>
 #include <memory>
+#include <utility>
+
+struct emplace_value_t {}; // Tag selecting the in-place value constructor of Node
 
 template <typename T>
 class Node {
@@ -9,11 +12,34 @@ public:
     std::vector<std::shared_ptr<Node<T>>> children;
 
     Node(const T& value) : data(value) {}
+    Node(T&& value) : data(std::move(value)) {}
+
+    template <typename... Args>
+    Node(emplace_value_t, Args&&... args) : data(std::forward<Args>(args)...) {} // Constructs the value in place
+
+    Node(const Node&) = default;
+    Node(Node&&) = default;
+    Node& operator=(const Node&) = default;
+    Node& operator=(Node&&) = default;
 
-    T get_value() const {
+    ~Node() { // Frees the descendants in a loop, nested destructors would take one stack frame per level of a deep chain
+        while (!children.empty()) {
+            std::shared_ptr<Node<T>> child = std::move(children.back());
+            children.pop_back();
+            if (child.use_count() == 1) { // Ours alone: take over its children, so it is freed without any
+                for (auto& grandchild : child->children) children.push_back(std::move(grandchild));
+                child->children.clear();
+            }
+        }
+    }
+
+    const T& get_value() const {
         return data;
     }
-    void set_value(T value) {
+    void set_value(const T& value) {
         data = value;
     }
+    void set_value(T&& value) {
+        data = std::move(value);
+    }
 };
@@ -0,0 +1,390 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <queue>
+#include <utility>
+#include <vector>
+#include "Node.hpp"
+#include "Tree.hpp"
+
+// Read-only tree stored as balanced parentheses: a pre-order walk writes an opening bit (1) when it enters a node
+// and a closing bit (0) when it leaves it, about 2 bits per node. Nodes are identified by their pre-order index and
+// navigation uses rank/select and excess searches over the bits. Values are packed in pre-order.
+template <typename T>
+class SuccinctTree {
+public:
+    static const std::size_t npos = static_cast<std::size_t>(-1); // Returned when a node does not exist
+
+private:
+    enum { WORD_BITS = 64, BLOCK_WORDS = 16, BLOCK_BITS = WORD_BITS * BLOCK_WORDS };
+
+    std::vector<std::uint64_t> bits; // Parentheses, position i is bit i % 64 of word i / 64
+    std::size_t length; // Number of parentheses, twice the number of nodes
+    std::vector<T> values; // Node values in pre-order
+    std::vector<std::uint64_t> block_rank; // Opening parentheses before each block
+    std::vector<std::int8_t> word_min; // Minimum excess at the 64 boundaries of a word, relative to its first one
+    std::vector<std::int32_t> min_tree; // Segment tree of the minimum absolute excess in each block
+    std::size_t leaves; // Number of leaves in min_tree
+
+    // The excess at boundary k (before position k) is the number of opening minus closing parentheses in [0, k).
+
+    bool bit(std::size_t i) const {
+        return (bits[i / WORD_BITS] >> (i % WORD_BITS)) & 1;
+    }
+
+    std::size_t rank1(std::size_t i) const { // Opening parentheses in [0, i)
+        std::size_t count = block_rank[i / BLOCK_BITS];
+        for (std::size_t w = i / BLOCK_BITS * BLOCK_WORDS; w < i / WORD_BITS; ++w) {
+            count += __builtin_popcountll(bits[w]);
+        }
+        if (i % WORD_BITS) {
+            count += __builtin_popcountll(bits[i / WORD_BITS] & ((std::uint64_t(1) << (i % WORD_BITS)) - 1));
+        }
+        return count;
+    }
+
+    std::size_t select1(std::size_t id) const { // Position of the opening parenthesis of pre-order node id
+        std::size_t lo = 0, hi = block_rank.size(); // Last block with fewer than id + 1 ones before it
+        while (hi - lo > 1) {
+            std::size_t mid = (lo + hi) / 2;
+            if (block_rank[mid] <= id) lo = mid; else hi = mid;
+        }
+        std::size_t remaining = id - block_rank[lo];
+        std::size_t w = lo * BLOCK_WORDS;
+        while (true) {
+            std::size_t ones = __builtin_popcountll(bits[w]);
+            if (remaining < ones) break;
+            remaining -= ones;
+            ++w;
+        }
+        std::uint64_t word = bits[w];
+        for (; remaining > 0; --remaining) {
+            word &= word - 1; // Clear the lowest set bit
+        }
+        return w * WORD_BITS + __builtin_ctzll(word);
+    }
+
+    long long excess(std::size_t k) const {
+        return 2 * static_cast<long long>(rank1(k)) - static_cast<long long>(k);
+    }
+
+    long long word_excess(std::size_t w) const {
+        return 2 * static_cast<long long>(__builtin_popcountll(bits[w])) - WORD_BITS;
+    }
+
+    std::size_t first_block(std::size_t node, std::size_t lo, std::size_t hi, std::size_t from, long long target) const {
+        if (hi <= from || min_tree[node] > target) return npos;
+        if (hi - lo == 1) return lo;
+        std::size_t mid = (lo + hi) / 2;
+        std::size_t found = first_block(2 * node, lo, mid, from, target);
+        return found != npos ? found : first_block(2 * node + 1, mid, hi, from, target);
+    }
+
+    std::size_t last_block(std::size_t node, std::size_t lo, std::size_t hi, std::size_t upto, long long target) const {
+        if (lo > upto || min_tree[node] > target) return npos;
+        if (hi - lo == 1) return lo;
+        std::size_t mid = (lo + hi) / 2;
+        std::size_t found = last_block(2 * node + 1, mid, hi, upto, target);
+        return found != npos ? found : last_block(2 * node, lo, mid, upto, target);
+    }
+
+    std::size_t scan_forward(std::size_t k, long long d, long long target) const { // Word starting at k holds a match
+        while (d > target) {
+            d += bit(k) ? 1 : -1;
+            ++k;
+        }
+        return k;
+    }
+
+    std::size_t scan_backward(std::size_t w, long long d, long long target) const { // Last match in word w, d at its start
+        std::size_t k = w * WORD_BITS, found = k;
+        for (std::size_t t = 0; t < WORD_BITS; ++t, ++k) {
+            if (d <= target) found = k;
+            d += bit(k) ? 1 : -1;
+        }
+        return found;
+    }
+
+    std::size_t forward_search(std::size_t k, long long target) const { // First boundary after k with excess <= target
+        long long d = excess(k);
+        while (k < length && k % WORD_BITS) { // Rest of the current word
+            d += bit(k) ? 1 : -1;
+            ++k;
+            if (d <= target) return k;
+        }
+        while (k < length && k % BLOCK_BITS) { // Rest of the current block, a word at a time
+            std::size_t w = k / WORD_BITS;
+            if (d + word_min[w] <= target) return scan_forward(k, d, target);
+            d += word_excess(w);
+            k += WORD_BITS;
+        }
+        if (k >= length) { // The word loop can end on boundary `length`, which no word minimum covers
+            return k == length && d <= target ? k : npos;
+        }
+        std::size_t block = first_block(1, 0, leaves, k / BLOCK_BITS, target);
+        if (block == npos) return npos;
+        k = block * BLOCK_BITS;
+        d = excess(k);
+        while (d + word_min[k / WORD_BITS] > target) {
+            d += word_excess(k / WORD_BITS);
+            k += WORD_BITS;
+        }
+        return scan_forward(k, d, target);
+    }
+
+    std::size_t backward_search(std::size_t k, long long target) const { // Last boundary before k with excess <= target
+        long long d = excess(k);
+        while (k > 0 && k % WORD_BITS) { // Rest of the current word
+            --k;
+            d -= bit(k) ? 1 : -1;
+            if (d <= target) return k;
+        }
+        while (k > 0 && k % BLOCK_BITS) { // Rest of the current block, a word at a time
+            std::size_t w = k / WORD_BITS - 1;
+            long long start = d - word_excess(w);
+            if (start + word_min[w] <= target) return scan_backward(w, start, target);
+            d = start;
+            k -= WORD_BITS;
+        }
+        if (k == 0) return npos;
+        std::size_t block = last_block(1, 0, leaves, k / BLOCK_BITS - 1, target);
+        if (block == npos) return npos;
+        k = (block + 1) * BLOCK_BITS;
+        d = excess(k);
+        while (true) {
+            std::size_t w = k / WORD_BITS - 1;
+            long long start = d - word_excess(w);
+            if (start + word_min[w] <= target) return scan_backward(w, start, target);
+            d = start;
+            k -= WORD_BITS;
+        }
+    }
+
+    std::size_t find_close(std::size_t pos) const { // Closing parenthesis matching the opening one at pos
+        return forward_search(pos + 1, excess(pos)) - 1;
+    }
+
+    std::size_t next_sibling_pos(std::size_t pos) const {
+        std::size_t next = find_close(pos) + 1;
+        return next < length && bit(next) ? next : npos;
+    }
+
+    std::size_t first_child_pos(std::size_t pos) const {
+        return pos + 1 < length && bit(pos + 1) ? pos + 1 : npos;
+    }
+
+    void build_directories() { // Rank samples, word minimums and the block min tree
+        std::size_t blocks = length / BLOCK_BITS + 1; // Boundary `length` belongs to the last block
+        block_rank.assign(blocks, 0);
+        std::vector<std::int32_t> block_min(blocks, INT32_MAX);
+        long long d = 0;
+        std::size_t ones = 0;
+        for (std::size_t k = 0; ; ++k) {
+            std::size_t block = k / BLOCK_BITS;
+            if (k % BLOCK_BITS == 0) block_rank[block] = ones;
+            if (d < block_min[block]) block_min[block] = static_cast<std::int32_t>(d);
+            if (k == length) break;
+            if (bit(k)) {
+                ++d;
+                ++ones;
+            } else {
+                --d;
+            }
+        }
+
+        word_min.assign(length / WORD_BITS + 1, 0);
+        for (std::size_t w = 0; w < word_min.size(); ++w) {
+            long long relative = 0, lowest = 0;
+            for (std::size_t t = 0; t + 1 < WORD_BITS && w * WORD_BITS + t < length; ++t) {
+                relative += bit(w * WORD_BITS + t) ? 1 : -1;
+                if (relative < lowest) lowest = relative;
+            }
+            word_min[w] = static_cast<std::int8_t>(lowest);
+        }
+
+        leaves = 1;
+        while (leaves < blocks) leaves *= 2;
+        min_tree.assign(2 * leaves, INT32_MAX);
+        for (std::size_t block = 0; block < blocks; ++block) {
+            min_tree[leaves + block] = block_min[block];
+        }
+        for (std::size_t node = leaves - 1; node > 0; --node) {
+            min_tree[node] = std::min(min_tree[2 * node], min_tree[2 * node + 1]);
+        }
+    }
+
+public:
+    template <int K>
+    explicit SuccinctTree(const Tree<T, K>& tree) : length(0), leaves(1) { // Encodes any tree in pre-order
+        std::vector<std::pair<const Node<T>*, std::size_t>> pending; // Node and the index of its next child
+        auto push_bit = [this](bool open) {
+            if (length % WORD_BITS == 0) bits.push_back(0);
+            if (open) bits.back() |= std::uint64_t(1) << (length % WORD_BITS);
+            ++length;
+        };
+        if (tree.get_root()) {
+            pending.push_back(std::make_pair(tree.get_root().get(), std::size_t(0)));
+            values.push_back(tree.get_root()->get_value());
+            push_bit(true);
+        }
+        while (!pending.empty()) {
+            auto& top = pending.back();
+            if (top.second < top.first->children.size()) {
+                const Node<T>* child = top.first->children[top.second++].get();
+                pending.push_back(std::make_pair(child, std::size_t(0)));
+                values.push_back(child->get_value());
+                push_bit(true);
+            } else {
+                pending.pop_back();
+                push_bit(false);
+            }
+        }
+        bits.shrink_to_fit();
+        values.shrink_to_fit();
+        build_directories();
+    }
+
+    std::size_t size() const { // Number of nodes
+        return length / 2;
+    }
+
+    const T& value(std::size_t node) const {
+        return values[node];
+    }
+
+    bool is_leaf(std::size_t node) const {
+        return first_child_pos(select1(node)) == npos;
+    }
+
+    std::size_t parent(std::size_t node) const { // npos for the root
+        std::size_t pos = select1(node);
+        if (pos == 0) return npos;
+        return rank1(backward_search(pos, excess(pos) - 1));
+    }
+
+    std::size_t first_child(std::size_t node) const {
+        return is_leaf(node) ? npos : node + 1; // Pre-order puts the first child right after its parent
+    }
+
+    std::size_t next_sibling(std::size_t node) const {
+        std::size_t pos = next_sibling_pos(select1(node));
+        return pos == npos ? npos : rank1(pos);
+    }
+
+    std::size_t child(std::size_t node, std::size_t index) const { // The index-th child, or npos
+        std::size_t pos = first_child_pos(select1(node));
+        for (; pos != npos && index > 0; --index) {
+            pos = next_sibling_pos(pos);
+        }
+        return pos == npos ? npos : rank1(pos);
+    }
+
+    std::size_t child_count(std::size_t node) const {
+        std::size_t count = 0;
+        for (std::size_t pos = first_child_pos(select1(node)); pos != npos; pos = next_sibling_pos(pos)) {
+            ++count;
+        }
+        return count;
+    }
+
+    std::size_t subtree_size(std::size_t node) const { // Nodes in the subtree, including node itself
+        std::size_t pos = select1(node);
+        return (find_close(pos) - pos + 1) / 2;
+    }
+
+    std::size_t depth(std::size_t node) const { // The root has depth 0
+        return static_cast<std::size_t>(excess(select1(node)));
+    }
+
+    std::size_t structure_bytes() const { // Parentheses plus the rank and excess directories
+        return bits.capacity() * sizeof(std::uint64_t) + block_rank.capacity() * sizeof(std::uint64_t) +
+               word_min.capacity() * sizeof(std::int8_t) + min_tree.capacity() * sizeof(std::int32_t);
+    }
+
+    std::size_t value_bytes() const {
+        return values.capacity() * sizeof(T);
+    }
+
+    // Pre-Order Iterator, values are stored in this order so it is a sequential scan
+    class PreOrderIterator {
+    private:
+        const SuccinctTree* tree;
+        std::size_t id;
+    public:
+        PreOrderIterator(const SuccinctTree* tree, std::size_t id) : tree(tree), id(id) {}
+
+        PreOrderIterator& operator++() {
+            ++id;
+            return *this;
+        }
+
+        bool operator!=(const PreOrderIterator& other) const {
+            return id != other.id;
+        }
+
+        const T& operator*() const {
+            return tree->values[id];
+        }
+
+        std::size_t node() const { // Pre-order index of the current node
+            return id;
+        }
+    };
+
+    // BFS Iterator
+    class BFSIterator {
+    private:
+        const SuccinctTree* tree;
+        std::queue<std::size_t> positions; // Opening parentheses of the nodes still to visit
+        std::size_t pos;
+    public:
+        BFSIterator(const SuccinctTree* tree, std::size_t pos) : tree(tree), pos(pos) {}
+
+        BFSIterator& operator++() {
+            if (pos == npos) return *this;
+            for (std::size_t child = tree->first_child_pos(pos); child != npos; child = tree->next_sibling_pos(child)) {
+                positions.push(child); // Enqueue the children
+            }
+            if (!positions.empty()) {
+                pos = positions.front();
+                positions.pop();
+            } else {
+                pos = npos; // No more nodes to visit
+            }
+            return *this;
+        }
+
+        bool operator!=(const BFSIterator& other) const {
+            return pos != other.pos;
+        }
+
+        const T& operator*() const {
+            return tree->values[node()];
+        }
+
+        std::size_t node() const { // Pre-order index of the current node
+            return tree->rank1(pos);
+        }
+    };
+
+    PreOrderIterator begin_pre_order() const {
+        return PreOrderIterator(this, 0);
+    }
+
+    PreOrderIterator end_pre_order() const {
+        return PreOrderIterator(this, size());
+    }
+
+    BFSIterator begin_bfs_scan() const {
+        return BFSIterator(this, length ? 0 : npos);
+    }
+
+    BFSIterator end_bfs_scan() const {
+        return BFSIterator(this, npos);
+    }
+};
+
+template <typename T>
+const std::size_t SuccinctTree<T>::npos;
@@ -0,0 +1,111 @@
+#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN // The test program's main, the test cases are in test.cpp
+#include "doctest.h"
+#include "AllocationCounter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+using namespace doctest;
+
+// Global operator new and delete replacements that count every allocation and release of the test program.
+static std::atomic<std::size_t> allocation_count(0);
+static std::atomic<std::size_t> allocated_bytes(0);
+static std::atomic<std::size_t> release_count(0);
+
+AllocationCount allocations_so_far()
+{
+    return AllocationCount{allocation_count.load(std::memory_order_relaxed), allocated_bytes.load(std::memory_order_relaxed),
+                           release_count.load(std::memory_order_relaxed)};
+}
+
+static void* counted_malloc(std::size_t size) noexcept
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+static void* counted_aligned_malloc(std::size_t size, std::align_val_t alignment) noexcept
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    std::size_t align = static_cast<std::size_t>(alignment);
+    return std::aligned_alloc(align, (size + align - 1) / align * align); // aligned_alloc wants a multiple
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* p = counted_malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (void* p = counted_malloc(size)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_malloc(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return counted_malloc(size);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = counted_aligned_malloc(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    if (void* p = counted_aligned_malloc(size, alignment)) return p;
+    throw std::bad_alloc();
+}
+
+static void counted_free(void* p) noexcept
+{
+    if (p) release_count.fetch_add(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+void operator delete(void* p) noexcept { counted_free(p); }
+void operator delete[](void* p) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::align_val_t) noexcept { counted_free(p); }
+void operator delete(void* p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+void operator delete[](void* p, std::size_t, std::align_val_t) noexcept { counted_free(p); }
+
+// Console output plus the allocations and bytes of every test case: ./test --reporters=allocations
+struct ReporterAllocations : public ConsoleReporter
+{
+    AllocationCount start;
+    std::string name;
+
+    ReporterAllocations(const ContextOptions &input_options)
+            : ConsoleReporter(input_options), start(), name() {}
+
+    void test_case_start(const TestCaseData &in) override
+    {
+        ConsoleReporter::test_case_start(in);
+        name = in.m_name;
+        start = allocations_so_far(); // After our own bookkeeping
+    }
+
+    void test_case_end(const CurrentTestCaseStats &in) override
+    {
+        AllocationCount end = allocations_so_far();
+        ConsoleReporter::test_case_end(in);
+        std::cout << name << ": " << end.allocations - start.allocations << " allocations, "
+                  << end.bytes - start.bytes << " bytes" << std::endl;
+    }
+};
+
+REGISTER_REPORTER("allocations", 1, ReporterAllocations);
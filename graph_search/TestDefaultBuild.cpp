@@ -0,0 +1,79 @@
+// Tree in its default configuration, without TREE_STATS. test.cpp defines TREE_STATS for all of its cases, so this
+// file is the one place the shipped layout and the compiled-out counters are built and checked.
+#include "doctest.h"
+#include "Node.hpp"
+#include "Tree.hpp"
+#include <memory>
+#include <queue>
+#include <stack>
+#include <vector>
+
+#ifdef TREE_STATS
+#error "TestDefaultBuild.cpp must be built without TREE_STATS"
+#endif
+
+using namespace std;
+
+namespace {
+
+// A value type of this file only, so its Tree instantiations never meet the instrumented ones of test.cpp.
+struct Plain {
+    double value;
+
+    Plain(double value = 0) : value(value) {}
+
+    bool operator==(const Plain& other) const {
+        return value == other.value;
+    }
+
+    bool operator<(const Plain& other) const {
+        return value < other.value;
+    }
+
+    bool operator>(const Plain& other) const {
+        return value > other.value;
+    }
+};
+
+typedef shared_ptr<Node<Plain>> Link;
+
+bool zero(const TreeStats& stats) {
+    return stats.traversals == 0 && stats.nodes_visited == 0 && stats.pointer_copies == 0 && stats.find_comparisons == 0 &&
+           stats.heap_pushes == 0 && stats.heap_pops == 0 && stats.allocations == 0 && stats.reuses == 0;
+}
+
+} // namespace
+
+TEST_CASE("Default Build Keeps No Counters") {
+    Tree<Plain> tree;
+    vector<Link> nodes(1, tree.emplace_root(0.0));
+    for (int i = 1; i < 7; ++i) {
+        nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], double(i)));
+    }
+    size_t visited = 0;
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) ++visited;
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) ++visited;
+    for (auto it = tree.begin_in_order(); it != tree.end_in_order(); ++it) ++visited;
+    for (auto it = tree.begin_post_order(); it != tree.end_post_order(); ++it) ++visited;
+    for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) ++visited;
+    CHECK(visited == 5 * 7);
+    CHECK(tree.find_node(tree.get_root(), Node<Plain>(6.0)) == nodes[6]);
+    tree.add_sub_node(Node<Plain>(3.0), Node<Plain>(7.0));
+    tree.myHeap();
+    CHECK(tree.get_root()->get_value() == Plain(0.0));
+    CHECK(tree.remove_subtree(std::move(nodes[6])));
+    tree.emplace_child(nodes[2], 9.0);
+    CHECK(zero(tree.stats()));
+    tree.reset_stats();
+    CHECK(zero(tree.stats()));
+}
+
+TEST_CASE("Default Build Iterator Layout") {
+    // Only the vtable pointer, the current node and the traversal container: no counter pointer
+    const size_t base = sizeof(void*) + sizeof(Link);
+    CHECK(sizeof(Tree<Plain>::BinaryPreOrderIterator) == base + sizeof(stack<Link>));
+    CHECK(sizeof(Tree<Plain>::BinaryInOrderIterator) == base + sizeof(stack<Link>));
+    CHECK(sizeof(Tree<Plain>::BinaryPostOrderIterator) == base + sizeof(stack<Link>));
+    CHECK(sizeof(Tree<Plain>::DFSIterator) == base + sizeof(stack<Link>));
+    CHECK(sizeof(Tree<Plain>::BFSIterator) == base + sizeof(queue<Link>));
+}
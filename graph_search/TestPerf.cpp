@@ -0,0 +1,146 @@
+// Throughput floors, skipped by ./test since they need an idle CPU, and run by make perf. This file is built without
+// TREE_STATS and with -O2, like bench.cpp, so the floors time the iterators and operations as they ship. Each operation
+// is timed against a calibration loop over the same nodes in the same run and must stay within a fixed multiple of it.
+#include "doctest.h"
+#include "Node.hpp"
+#include "Tree.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#ifdef TREE_STATS
+#error "TestPerf.cpp must be built without TREE_STATS"
+#endif
+
+using namespace std;
+
+namespace {
+
+// A double of this file only, so its Tree instantiations never meet the instrumented ones of test.cpp.
+struct Sample {
+    double value;
+
+    Sample(double value = 0) : value(value) {}
+
+    bool operator==(const Sample& other) const {
+        return value == other.value;
+    }
+
+    bool operator<(const Sample& other) const {
+        return value < other.value;
+    }
+
+    bool operator>(const Sample& other) const {
+        return value > other.value;
+    }
+};
+
+const size_t perf_nodes = 1 << 17;
+
+template <typename F, typename Reset>
+double best_ns_per_node(F&& work, size_t nodes, Reset&& reset) { // Fastest of a few runs, the least disturbed by other processes
+    double best = 1e300;
+    for (int run = 0; run < 5; ++run) {
+        reset(); // Untimed, so every run starts from the same input
+        auto start = chrono::steady_clock::now();
+        work();
+        best = min(best, chrono::duration<double, nano>(chrono::steady_clock::now() - start).count());
+    }
+    return best / nodes;
+}
+
+template <typename F>
+double best_ns_per_node(F&& work, size_t nodes) {
+    return best_ns_per_node(work, nodes, [] {});
+}
+
+struct PerfTree { // A complete binary tree and its nodes in BFS order
+    Tree<Sample> tree;
+    vector<shared_ptr<Node<Sample>>> nodes;
+
+    PerfTree() {
+        nodes.reserve(perf_nodes);
+        nodes.push_back(tree.emplace_root(0.0));
+        for (size_t i = 1; i < perf_nodes; ++i) {
+            nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], 0.0));
+        }
+        scramble();
+    }
+
+    void scramble() { // Values in a fixed shuffled order, as sorting leaves them in order
+        for (size_t i = 0; i < nodes.size(); ++i) nodes[i]->set_value(double((i * 7919) % perf_nodes));
+    }
+
+    double baseline_ns() const { // Visiting every node without the tree's bookkeeping
+        volatile double sink = 0;
+        return best_ns_per_node([&] {
+            double sum = 0;
+            for (const auto& node : nodes) sum += node->get_value().value;
+            sink = sum;
+        }, nodes.size());
+    }
+
+    double heap_baseline_ns() { // The heap work of myHeap alone: every value through a priority_queue, back in BFS order
+        return best_ns_per_node([&] {
+            priority_queue<Sample, vector<Sample>, greater<Sample>> heap;
+            for (const auto& node : nodes) heap.push(node->get_value());
+            for (const auto& node : nodes) {
+                node->set_value(heap.top());
+                heap.pop();
+            }
+        }, nodes.size(), [this] { scramble(); });
+    }
+};
+
+template <typename Iterator>
+double traversal_ns(Iterator begin, Iterator end, size_t nodes) {
+    volatile double sink = 0;
+    return best_ns_per_node([&] {
+        double sum = 0;
+        for (auto it = begin; it != end; ++it) sum += (*it)->get_value().value;
+        sink = sum;
+    }, nodes);
+}
+
+// The allowed ratios are about twice the largest measured on one x86-64 machine with the makefile's flags, so only real
+// slowdowns fail there. Other machines and compilers may need them adjusted.
+void check_floor(const string& operation, double ns, double baseline_ns, double max_ratio) {
+    INFO(operation << ": " << ns << " ns/node, calibration " << baseline_ns << " ns/node, ratio " << ns / baseline_ns
+         << ", allowed " << max_ratio);
+    CHECK(ns <= baseline_ns * max_ratio);
+}
+
+} // namespace
+
+TEST_SUITE("perf" * doctest::skip()) {
+    TEST_CASE("Traversal Throughput") {
+        PerfTree perf;
+        const Tree<Sample>& tree = perf.tree;
+        double baseline = perf.baseline_ns();
+        check_floor("pre-order", traversal_ns(tree.begin_pre_order(), tree.end_pre_order(), perf_nodes), baseline, 8);
+        check_floor("in-order", traversal_ns(tree.begin_in_order(), tree.end_in_order(), perf_nodes), baseline, 12);
+        check_floor("post-order", traversal_ns(tree.begin_post_order(), tree.end_post_order(), perf_nodes), baseline, 10);
+        check_floor("BFS", traversal_ns(tree.begin_bfs_scan(), tree.end_bfs_scan(), perf_nodes), baseline, 11);
+        check_floor("DFS", traversal_ns(tree.begin_dfs_scan(), tree.end_dfs_scan(), perf_nodes), baseline, 8);
+    }
+
+    TEST_CASE("find_node Throughput") {
+        PerfTree perf;
+        double baseline = perf.baseline_ns();
+        Node<Sample> missing(-1.0); // Not in the tree, so every node is compared
+        double ns = best_ns_per_node([&] { CHECK_FALSE(perf.tree.find_node(perf.tree.get_root(), missing)); }, perf_nodes);
+        check_floor("find_node", ns, baseline, 3);
+    }
+
+    TEST_CASE("myHeap Throughput") {
+        PerfTree perf;
+        double baseline = perf.heap_baseline_ns();
+        double ns = best_ns_per_node([&] { perf.tree.myHeap(); }, perf_nodes, [&] { perf.scramble(); });
+        check_floor("myHeap", ns, baseline, 3); // Two BFS queues on top of the same heap work
+        CHECK(perf.tree.get_root()->get_value() == Sample(0.0));
+    }
+}
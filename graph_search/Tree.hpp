@@ -5,14 +5,68 @@
 #include <stack>
 #include <memory>
 #include <algorithm>
+#include <cstddef>
 #include "Node.hpp"
 #include <iostream>
+#include <type_traits>
 #include <utility>
+#include <iterator>
+#include <functional>
+
+// Operation counts of one tree, for attributing time to operations. They are only kept when TREE_STATS is defined
+// before Tree.hpp is included (e.g. -DTREE_STATS); otherwise the counting compiles to nothing and stats() is all zero.
+// The counters are plain integers, so trees shared between threads should not be profiled this way.
+struct TreeStats {
+    std::size_t traversals = 0; // Iterators started on a non-empty tree
+    std::size_t nodes_visited = 0; // Nodes reached by those iterators
+    std::size_t pointer_copies = 0; // shared_ptr copies made by the iterators (stacks, queues, current node)
+    std::size_t find_comparisons = 0; // Value comparisons made while searching for a node
+    std::size_t heap_pushes = 0; // myHeap priority queue operations
+    std::size_t heap_pops = 0;
+    std::size_t allocations = 0; // Node allocations, plus one per compacted block
+    std::size_t reuses = 0; // Nodes taken from the free list instead
+};
+
+// Bytes held by one tree, by category; see Tree::memory_usage().
+struct TreeMemory {
+    std::size_t nodes = 0;
+    std::size_t payload = 0; // The values, sizeof(T) per node
+    std::size_t child_links = 0; // children vectors: the vector objects and their buffers of shared_ptr
+    std::size_t control = 0; // shared_ptr control blocks, padding inside Node and unused arena slots
+    std::size_t allocator = 0; // Estimated malloc headers and size rounding
+    std::size_t free_list = 0; // Everything held by nodes waiting in the free list
+    std::size_t allocations = 0; // Heap blocks behind the tree, free list excluded
+
+    std::size_t total() const {
+        return payload + child_links + control + allocator + free_list;
+    }
+
+    double per_node(std::size_t bytes) const { // Average of any category over the nodes of the tree
+        return nodes ? double(bytes) / nodes : 0;
+    }
+};
+
+#ifdef TREE_STATS
+#define TREE_COUNT(stats, field, amount) ((stats) ? (void)((stats)->field += (amount)) : (void)0)
+#else
+#define TREE_COUNT(stats, field, amount) ((void)0)
+#endif
 
 template <typename T>
 class BaseIterator {
 protected:
     std::shared_ptr<Node<T>> _current; // Holds the current node
+#ifdef TREE_STATS
+    TreeStats* _stats = nullptr; // Counters of the tree that created the iterator
+#endif
+
+    void attach(TreeStats* stats) { // Counts into stats from now on, when counting is compiled in
+#ifdef TREE_STATS
+        _stats = stats;
+#else
+        (void)stats;
+#endif
+    }
 public:
     virtual ~BaseIterator() = default; // Virtual destructor
     virtual BaseIterator& operator++() = 0; // Pure virtual increment operator
@@ -29,8 +83,10 @@ protected:
     void traverse_left(std::shared_ptr<Node<T>> node) { // Helper function to traverse left subtree
         while (node != nullptr) {
             _node_stack.push(node); // Pushes the node to the stack
+            TREE_COUNT(this->_stats, pointer_copies, 1);
             if (!node->children.empty()) {
                 node = node->children[0]; // Move to the left child
+                TREE_COUNT(this->_stats, pointer_copies, 1);
             } else {
                 node = nullptr;
             }
@@ -38,10 +94,272 @@ protected:
     }
 };
 
+template <typename T>
+const T& order_key(const T& value) { // Key myHeap orders values by, overload it to return a cheaper equivalent key by value
+    return value;
+}
+
+enum class Order { DFS, BFS }; // Memory order used when compacting a tree (DFS is pre-order)
+
+// One contiguous block of nodes made by compact() or assign(). The child links inside the block are aliasing pointers
+// that own the block, so the block would keep itself alive. Trees, snapshots and detached subtrees own this instead,
+// and the last of them to let go unlinks the nodes, which frees the block once no outside handle is left.
+template <typename T>
+struct TreeArena {
+    std::shared_ptr<std::vector<Node<T>>> block;
+
+    explicit TreeArena(std::shared_ptr<std::vector<Node<T>>> nodes) : block(std::move(nodes)) {}
+    TreeArena(const TreeArena&) = delete;
+    TreeArena& operator=(const TreeArena&) = delete;
+
+    ~TreeArena() {
+        for (auto& node : *block) node.children.clear();
+    }
+
+    bool contains(const Node<T>* node) const {
+        return !block->empty() && node >= block->data() && node < block->data() + block->size();
+    }
+};
+
+// Not thread-safe, snapshots included: a snapshot shares its nodes and version marker with the tree, whether a write
+// copies a node is decided from shared_ptr use counts, and writes record their search path in per-tree scratch. Use a
+// tree and all of its snapshots from one thread at a time. To hand a version to another thread, copy it on the owning
+// thread (Tree(const Tree&) shares nothing) and pass the copy.
 template <typename T, int K = 2>
 class Tree {
 private:
     std::shared_ptr<Node<T>> root; // Root node of the tree
+    std::shared_ptr<TreeArena<T>> arena; // Contiguous node storage created by the last compact() or assign()
+    std::vector<std::shared_ptr<Node<T>>> free_nodes; // Removed nodes kept for reuse by later insertions
+    mutable std::shared_ptr<char> versions; // Shared with every snapshot, nodes are copied on write while shared
+    std::vector<std::size_t> path; // Child indices from the root recorded by find_path
+    std::size_t changes; // Bumped by every write, so viewers can tell whether anything changed since they last looked
+#ifdef TREE_STATS
+    mutable TreeStats counters;
+#endif
+
+    TreeStats* stats_pointer() const { // Where iterators and operations count, nullptr when counting is compiled out
+#ifdef TREE_STATS
+        return &counters;
+#else
+        return nullptr;
+#endif
+    }
+
+    bool copy_on_write() const { // True while a snapshot may still reference our nodes
+        return versions && versions.use_count() > 1;
+    }
+
+    struct SearchStep { // A node on the way down an iterative search and the index of its next child
+        const std::shared_ptr<Node<T>>* node;
+        std::size_t next;
+    };
+
+    static const std::size_t shallow_levels = 32; // Searched on the call stack, deeper levels spill to the heap
+
+    template <typename Match>
+    static const std::shared_ptr<Node<T>>* search(const std::shared_ptr<Node<T>>& start, const Match& match,
+                                                  std::vector<std::size_t>* found_path) { // First pre-order match
+        if (!start) return nullptr; // without recursion, so deep chains cannot overflow the stack
+        if (match(*start)) return &start;
+        SearchStep shallow[shallow_levels]; // Ordinary trees never allocate
+        std::vector<SearchStep> deep;
+        std::size_t depth = 0;
+        auto push = [&](const std::shared_ptr<Node<T>>* node) {
+            if (depth < shallow_levels) shallow[depth] = SearchStep{node, 0};
+            else deep.push_back(SearchStep{node, 0});
+            ++depth;
+        };
+        auto at = [&](std::size_t level) -> SearchStep& {
+            return level < shallow_levels ? shallow[level] : deep[level - shallow_levels];
+        };
+        push(&start);
+        while (depth > 0) {
+            SearchStep& top = at(depth - 1);
+            const auto& children = (*top.node)->children;
+            if (top.next == children.size()) {
+                if (--depth >= shallow_levels) deep.pop_back();
+                continue;
+            }
+            const std::shared_ptr<Node<T>>* child = &children[top.next++];
+            if (!*child) continue;
+            if (match(**child)) {
+                if (found_path) {
+                    for (std::size_t level = 0; level < depth; ++level) found_path->push_back(at(level).next - 1);
+                }
+                return child;
+            }
+            push(child);
+        }
+        return nullptr;
+    }
+
+    template <typename Match>
+    bool find_path(const std::shared_ptr<Node<T>>& node, const Match& match) { // Records the path to the first pre-order match
+        return search(node, match, &path) != nullptr;
+    }
+
+    Node<T>* writable_path(std::size_t length) { // Follows the recorded path, copying nodes shared with a snapshot
+        std::shared_ptr<Node<T>>* slot = &root;
+        for (std::size_t i = 0; ; ++i) {
+            if (copy_on_write() && slot->use_count() > 1) {
+                *slot = acquire_node(**slot); // The copy shares the children of the original
+            }
+            if (i == length) return slot->get();
+            slot = &(*slot)->children[path[i]];
+        }
+    }
+
+    Node<T>* writable(const std::shared_ptr<Node<T>>& handle) { // Returns the node to modify in place of a handle
+        if (!copy_on_write()) return handle.get();
+        const Node<T>* target = handle.get();
+        path.clear();
+        if (!find_path(root, [target](const Node<T>& node) { return &node == target; })) {
+            throw std::runtime_error("Node is not part of the current version of the tree");
+        }
+        return writable_path(path.size());
+    }
+
+    void unshare_all() { // Copies every node shared with a snapshot, used before rewriting all values
+        if (!copy_on_write()) return;
+        std::queue<std::shared_ptr<Node<T>>*> slots;
+        slots.push(&root);
+        while (!slots.empty()) {
+            auto slot = slots.front();
+            slots.pop();
+            if (!*slot) continue;
+            if (slot->use_count() > 1) {
+                *slot = acquire_node(**slot);
+            }
+            for (auto& child : (*slot)->children) {
+                slots.push(&child);
+            }
+        }
+    }
+
+    template <typename... Args>
+    std::shared_ptr<Node<T>> acquire_node(Args&&... args) { // Reuses a free node when possible, allocates otherwise
+        if (free_nodes.empty()) {
+            TREE_COUNT(stats_pointer(), allocations, 1);
+            return std::make_shared<Node<T>>(std::forward<Args>(args)...);
+        }
+        TREE_COUNT(stats_pointer(), reuses, 1);
+        auto node = std::move(free_nodes.back());
+        free_nodes.pop_back();
+        reuse_node(*node, std::forward<Args>(args)...);
+        return node;
+    }
+
+    // Overwrite a free node in place, so its children buffer is reused too
+    static void reuse_node(Node<T>& node, const Node<T>& source) {
+        node.data = source.data;
+        node.children.assign(source.children.begin(), source.children.end());
+    }
+
+    static void reuse_node(Node<T>& node, Node<T>&& source) {
+        node.data = std::move(source.data);
+        node.children.assign(std::make_move_iterator(source.children.begin()), std::make_move_iterator(source.children.end()));
+        source.children.clear();
+    }
+
+    template <typename... Args>
+    static void reuse_node(Node<T>& node, emplace_value_t, Args&&... args) {
+        node.data = T(std::forward<Args>(args)...);
+        node.children.clear();
+    }
+
+    void recycle(std::shared_ptr<Node<T>> node) { // Moves the nodes of a removed subtree to the free list
+        std::size_t first = free_nodes.size();
+        std::stack<std::shared_ptr<Node<T>>> pending;
+        pending.push(std::move(node));
+        while (!pending.empty()) {
+            auto current = std::move(pending.top());
+            pending.pop();
+            if (in_arena(current.get())) {
+                if (copy_on_write()) continue; // A snapshot may still show the slot
+                current = arena_link(current); // The slot is reused, an owning handle would tie the arena to itself
+            } else if (current.use_count() != 1) {
+                continue; // Still referenced outside the tree, leave that subtree intact
+            }
+            for (auto it = current->children.rbegin(); it != current->children.rend(); ++it) {
+                pending.push(std::move(*it)); // In reverse, so nodes are freed in pre-order
+            }
+            current->children.clear(); // Keeps the capacity for the next use
+            free_nodes.push_back(std::move(current));
+        }
+        // Rebuilding in pre-order takes each node back with the children buffer it had
+        std::reverse(free_nodes.begin() + first, free_nodes.end());
+    }
+
+    std::shared_ptr<Node<T>> unlink(const std::shared_ptr<Node<T>>& node) { // Removes a node from its parent and returns it
+        if (!node) return nullptr;
+        const Node<T>* target = node.get();
+        path.clear();
+        if (!find_path(root, [target](const Node<T>& current) { return &current == target; })) {
+            return nullptr; // Not part of this tree
+        }
+        if (path.empty()) {
+            ++changes;
+            auto removed = std::move(root); // Leaves the tree empty
+            return removed;
+        }
+        auto parent = writable_path(path.size() - 1);
+        auto it = parent->children.begin() + path.back();
+        auto removed = std::move(*it);
+        parent->children.erase(it);
+        ++changes;
+        return removed;
+    }
+
+    static std::size_t control_block_bytes() { // Control block make_shared puts in front of the object
+#ifdef __GLIBCXX__
+        return sizeof(void*) + 2 * sizeof(int); // Vtable pointer and two atomic int counts
+#else
+        return sizeof(void*) + 2 * sizeof(long);
+#endif
+    }
+
+    static std::size_t allocator_overhead(std::size_t bytes) { // Bytes malloc adds to a block: glibc-style size word,
+        const std::size_t word = sizeof(void*); // rounding to two words and a four-word minimum
+        std::size_t chunk = std::max(4 * word, (bytes + word + 2 * word - 1) / (2 * word) * (2 * word));
+        return chunk - bytes;
+    }
+
+    static void add_block(TreeMemory& usage, std::size_t bytes) { // Counts one heap block
+        ++usage.allocations;
+        usage.allocator += allocator_overhead(bytes);
+    }
+
+    template <typename Parent>
+    void adopt_arena(const std::shared_ptr<std::vector<Node<T>>>& block, const Parent& parent_of) { // Links every node of
+        for (std::size_t i = 1; i < block->size(); ++i) { // the block under its parent and makes the block the tree
+            (*block)[parent_of(i)].children.push_back(std::shared_ptr<Node<T>>(block, &(*block)[i]));
+        }
+        if (arena) { // Free slots of the old block would tie it to the new one
+            free_nodes.erase(std::remove_if(free_nodes.begin(), free_nodes.end(),
+                                            [this](const std::shared_ptr<Node<T>>& node) { return in_arena(node.get()); }),
+                             free_nodes.end());
+        }
+        arena = std::make_shared<TreeArena<T>>(block);
+        root = std::shared_ptr<Node<T>>(arena, &block->front()); // Outside the block, so it may own the arena
+    }
+
+    std::shared_ptr<Node<T>> arena_link(const std::shared_ptr<Node<T>>& node) const { // How a node is linked from inside
+        return in_arena(node.get()) ? std::shared_ptr<Node<T>>(arena->block, node.get()) : node; // the tree
+    }
+
+    std::shared_ptr<Node<T>> arena_handle(const std::shared_ptr<Node<T>>& node) const { // How a node is handed out of the
+        return in_arena(node.get()) ? std::shared_ptr<Node<T>>(arena, node.get()) : node; // tree, keeping it whole
+    }
+
+    bool in_arena(const Node<T>* node) const { // Checks whether a node lives in the current arena
+        return arena && arena->contains(node);
+    }
+
+    std::size_t footprint() const { // Estimated heap bytes held by the nodes of the tree, free list excluded
+        TreeMemory usage = memory_usage();
+        return usage.total() - usage.free_list;
+    }
 
     void pre_order_helper(const std::shared_ptr<Node<T>>& node, std::vector<std::shared_ptr<Node<T>>>& nodes) const { // Pre-order traversal helper function
         if (!node) return;
@@ -72,15 +390,38 @@ private:
 
     void myHeapHelper(std::shared_ptr<Node<T>> node) { // Custom heap operation helper function
         if (!node) return;
+        // The default order_key() returns the value itself, there is no cheaper key worth storing next to it
+        typedef decltype(order_key(std::declval<const T&>())) KeyResult;
+        heap_fill(node, std::is_same<KeyResult, const T&>());
+    }
+
+    void heap_fill(const std::shared_ptr<Node<T>>& node, std::true_type) { // Min-heap of the values
+        std::priority_queue<T, std::vector<T>, std::greater<T>> minHeap;
+        heap_refill(node, minHeap, [](const T& value) -> const T& { return value; },
+                    [](const T& top) -> const T& { return top; });
+    }
+
+    void heap_fill(const std::shared_ptr<Node<T>>& node, std::false_type) { // Min-heap of values with their cached keys
+        typedef typename std::decay<decltype(order_key(std::declval<const T&>()))>::type Key;
+        typedef std::pair<Key, T> Entry; // Key computed once per value
+        struct KeyGreater {
+            bool operator()(const Entry& a, const Entry& b) const { return a.first > b.first; }
+        };
+        std::priority_queue<Entry, std::vector<Entry>, KeyGreater> minHeap;
+        heap_refill(node, minHeap, [](const T& value) { return Entry(order_key(value), value); },
+                    [](const Entry& top) -> const T& { return top.second; });
+    }
 
-        std::priority_queue<T, std::vector<T>, std::greater<T>> minHeap; // Min-heap to store node values
+    template <typename Heap, typename MakeEntry, typename ValueOf>
+    void heap_refill(const std::shared_ptr<Node<T>>& node, Heap& minHeap, const MakeEntry& make_entry, const ValueOf& value_of) {
         std::queue<std::shared_ptr<Node<T>>> nodeQueue; // Queue for level-order traversal
         nodeQueue.push(node);
 
         while (!nodeQueue.empty()) {
             auto current = nodeQueue.front(); // Get the front node from the queue
             nodeQueue.pop();
-            minHeap.push(current->get_value()); // Push the node value to the heap
+            minHeap.push(make_entry(current->get_value())); // Push the node value to the heap
+            TREE_COUNT(stats_pointer(), heap_pushes, 1);
 
             for (const auto& child : current->children) {
                 nodeQueue.push(child); // Enqueue the children
@@ -92,8 +433,9 @@ private:
         while (!fillQueue.empty()) {
             auto current = fillQueue.front(); // Get the front node from the queue
             fillQueue.pop();
-            current->set_value(minHeap.top()); // Set the node value to the top of the heap
+            current->set_value(value_of(minHeap.top())); // Set the node value to the top of the heap
             minHeap.pop();
+            TREE_COUNT(stats_pointer(), heap_pops, 1);
 
             for (const auto& child : current->children) {
                 fillQueue.push(child); // Enqueue the children
@@ -101,52 +443,333 @@ private:
         }
     }
 
+    Node<T>* checked_parent(const Node<T>& parent_node) { // Finds a parent that may take another child
+        path.clear();
+        TreeStats* stats = stats_pointer();
+        if (!find_path(root, [&parent_node, stats](const Node<T>& node) {
+                TREE_COUNT(stats, find_comparisons, 1);
+                return node.data == parent_node.data;
+            })) {
+            throw std::runtime_error("Parent node does not exist"); // Error if parent node not found
+        }
+        auto parent = writable_path(path.size()); // Find the parent node
+
+        if (parent->children.size() > K) {
+            throw std::runtime_error("Cannot add more children to this node"); // Error if children exceed the limit
+        }
+        return parent->children.size() < K ? parent : nullptr;
+    }
+
 public:
-    Tree() : root(nullptr) {} // Constructor initializes the root to nullptr
+    Tree() : root(nullptr), changes(0) {} // Constructor initializes the root to nullptr
+
+    Tree(const Tree& other) : root(nullptr), changes(other.changes) { // Copies every node, the copy starts with an empty
+        if (!other.root) return; // free list and shares nothing with the source, see snapshot() for an O(1) copy
+        root = std::make_shared<Node<T>>(other.root->data);
+        TREE_COUNT(stats_pointer(), allocations, 1);
+        std::vector<std::pair<const Node<T>*, Node<T>*>> pending(1, std::make_pair(other.root.get(), root.get()));
+        while (!pending.empty()) {
+            auto current = pending.back();
+            pending.pop_back();
+            current.second->children.reserve(current.first->children.size());
+            for (const auto& child : current.first->children) {
+                current.second->children.push_back(std::make_shared<Node<T>>(child->data));
+                TREE_COUNT(stats_pointer(), allocations, 1);
+                pending.emplace_back(child.get(), current.second->children.back().get());
+            }
+        }
+    }
+
+    Tree(Tree&&) = default;
+    Tree& operator=(Tree&&) = default;
+
+    Tree& operator=(const Tree& other) {
+        if (this != &other) *this = Tree(other);
+        return *this;
+    }
+
+    Tree snapshot() const { // O(1) read-only view for the same thread, later writes to either copy only the modified path
+        if (!versions) versions = std::make_shared<char>(0);
+        Tree view;
+        view.root = root;
+        view.arena = arena;
+        view.versions = versions;
+        view.changes = changes;
+        return view;
+    }
 
     void add_root(const Node<T>& root_node) { // Adds a root node to the tree
-        root = std::make_shared<Node<T>>(root_node);
+        root = acquire_node(root_node);
+        ++changes;
+    }
+
+    void add_root(Node<T>&& root_node) { // Adds a root node to the tree, moving its value and children
+        root = acquire_node(std::move(root_node));
+        ++changes;
+    }
+
+    template <typename... Args>
+    std::shared_ptr<Node<T>> emplace_root(Args&&... args) { // Constructs the root value in place
+        root = acquire_node(emplace_value_t(), std::forward<Args>(args)...);
+        ++changes;
+        return root;
     }
 
     void add_sub_node(const Node<T>& parent_node, const Node<T>& sub_node) { // Adds a sub-node to a given parent node
-        auto parent = find_node(root, parent_node); // Find the parent node
+        auto parent = checked_parent(parent_node);
+        if (parent) {
+            parent->children.push_back(acquire_node(sub_node)); // Add the sub-node to the parent
+            ++changes;
+        }
+    }
+
+    void add_sub_node(const Node<T>& parent_node, Node<T>&& sub_node) { // Adds a sub-node, moving its value and children
+        auto parent = checked_parent(parent_node);
+        if (parent) {
+            parent->children.push_back(acquire_node(std::move(sub_node)));
+            ++changes;
+        }
+    }
 
+    template <typename... Args>
+    std::shared_ptr<Node<T>> emplace_child(const std::shared_ptr<Node<T>>& parent, Args&&... args) { // Constructs a child value in place
         if (!parent) {
-            throw std::runtime_error("Parent node does not exist"); // Error if parent node not found
+            throw std::runtime_error("Parent node does not exist");
         }
-        if (parent->children.size() > K) {
-            throw std::runtime_error("Cannot add more children to this node"); // Error if children exceed the limit
+        if (parent->children.size() >= K) {
+            return nullptr; // The parent is full, like add_sub_node nothing is added
         }
-        if (parent && parent->children.size() < K) {
-            parent->children.push_back(std::make_shared<Node<T>>(sub_node)); // Add the sub-node to the parent
+        auto target = writable(parent);
+        target->children.push_back(acquire_node(emplace_value_t(), std::forward<Args>(args)...));
+        ++changes;
+        return target->children.back();
+    }
+
+    bool remove_subtree(std::shared_ptr<Node<T>> handle) { // Removes a subtree and recycles its nodes
+        auto removed = unlink(handle);
+        if (!removed) return false;
+        handle.reset(); // Drop our copy so a moved-in handle does not keep the root out of the free list
+        recycle(std::move(removed));
+        return true;
+    }
+
+    std::shared_ptr<Node<T>> detach(const std::shared_ptr<Node<T>>& handle) { // Unlinks a subtree and hands it to the caller
+        return arena_handle(unlink(handle)); // Keeps a compacted subtree whole after the tree is gone
+    }
+
+    bool reattach(const std::shared_ptr<Node<T>>& parent, std::shared_ptr<Node<T>> subtree) { // Links a detached subtree under a parent
+        if (!parent) {
+            throw std::runtime_error("Parent node does not exist");
         }
+        if (!subtree || parent->children.size() >= K) return false;
+        writable(parent)->children.push_back(arena_link(subtree));
+        ++changes;
+        return true;
+    }
+
+    std::size_t free_node_count() const { // Number of nodes waiting in the free list
+        return free_nodes.size();
+    }
+
+    void release_free_nodes() { // Returns the memory of the free list to the allocator
+        free_nodes.clear();
+        free_nodes.shrink_to_fit();
     }
 
     std::shared_ptr<Node<T>> find_node(const std::shared_ptr<Node<T>>& node, const Node<T>& target) { // Finds a node in the tree
-        if (!node) return nullptr;
-        if (node->data == target.data) return node; // Node found
-        for (const auto& child : node->children) {
-            auto found = find_node(child, target); // Recur on children
-            if (found) return found; // Node found in children
-        }
-        return nullptr;
+        TreeStats* stats = stats_pointer();
+        auto found = search(node, [&target, stats](const Node<T>& current) {
+            TREE_COUNT(stats, find_comparisons, 1);
+            return current.data == target.data;
+        }, nullptr);
+        return found ? *found : nullptr; // First match in pre-order
     }
 
     std::shared_ptr<Node<T>> get_root() const { // Returns the root node
         return root;
     }
 
+    std::size_t version() const { // Changes whenever the tree is modified through its own methods
+        return changes;
+    }
+
+    void touch() { // Marks the tree as modified after values were changed directly through node handles
+        ++changes;
+    }
+
+    // Bytes held by the tree, by category. Sizes of the objects are exact; heap blocks are estimated for a glibc-style
+    // malloc. Nodes shared with a snapshot are counted in full by both trees.
+    TreeMemory memory_usage() const {
+        typedef std::shared_ptr<Node<T>> Link;
+        TreeMemory usage;
+        std::size_t arena_nodes = 0;
+        std::vector<const Node<T>*> pending;
+        if (root) pending.push_back(root.get());
+        while (!pending.empty()) {
+            const Node<T>* node = pending.back();
+            pending.pop_back();
+            ++usage.nodes;
+            usage.payload += sizeof(T);
+            usage.child_links += sizeof(std::vector<Link>) + node->children.capacity() * sizeof(Link);
+            usage.control += sizeof(Node<T>) - sizeof(T) - sizeof(std::vector<Link>); // Padding
+            if (in_arena(node)) {
+                ++arena_nodes;
+            } else {
+                usage.control += control_block_bytes();
+                add_block(usage, control_block_bytes() + sizeof(Node<T>)); // Node allocated on its own by make_shared
+            }
+            if (node->children.capacity() > 0) add_block(usage, node->children.capacity() * sizeof(Link));
+            for (const auto& child : node->children) {
+                pending.push_back(child.get());
+            }
+        }
+        if (arena) { // One block for the owner, one for the vector and its control block, one for its nodes
+            const std::vector<Node<T>>& block = *arena->block;
+            usage.control += 2 * control_block_bytes() + sizeof(TreeArena<T>) + sizeof(std::vector<Node<T>>);
+            usage.control += (block.capacity() - arena_nodes) * sizeof(Node<T>); // Slots no longer in the tree
+            add_block(usage, control_block_bytes() + sizeof(TreeArena<T>));
+            add_block(usage, control_block_bytes() + sizeof(std::vector<Node<T>>));
+            if (block.capacity() > 0) add_block(usage, block.capacity() * sizeof(Node<T>));
+        }
+        for (const auto& node : free_nodes) {
+            TreeMemory held;
+            if (!in_arena(node.get())) {
+                held.control = control_block_bytes() + sizeof(Node<T>);
+                add_block(held, held.control);
+            }
+            if (node->children.capacity() > 0) {
+                held.child_links = node->children.capacity() * sizeof(Link);
+                add_block(held, held.child_links);
+            }
+            usage.free_list += held.total();
+        }
+        return usage;
+    }
+
+    TreeStats stats() const { // Counts since construction or reset_stats(), all zero unless TREE_STATS is defined
+        TreeStats* stats = stats_pointer();
+        return stats ? *stats : TreeStats();
+    }
+
+    void reset_stats() {
+        TreeStats* stats = stats_pointer();
+        if (stats) *stats = TreeStats();
+    }
+
+    template <typename Step>
+    const std::shared_ptr<Node<T>>& update_path(Step step) { // Walks down from the root while step(node) returns a
+        ++changes; // child index, and stops at a negative one. Nodes shared with a snapshot are copied before step sees
+        std::shared_ptr<Node<T>>* slot = &root; // them, so it may modify them. Returns the tree's own link to the last
+        while (*slot) { // node, valid until the tree changes shape; passing it rather than a copy to emplace_child or
+            if (copy_on_write() && slot->use_count() > 1) { // reattach keeps the node from being copied again
+                *slot = acquire_node(**slot);
+            }
+            int next = step(**slot);
+            if (next < 0) break;
+            slot = &(*slot)->children[next];
+        }
+        return *slot;
+    }
+
+    template <typename Rewrite>
+    void rewrite_values(Order order, Rewrite rewrite) { // Calls rewrite(i, value) on the i-th node in DFS or BFS order
+        unshare_all(); // Snapshots keep the old values
+        std::size_t i = 0;
+        if (order == Order::BFS) {
+            for (auto it = begin_bfs_scan(); it != end_bfs_scan(); ++it) rewrite(i++, (*it)->data);
+        } else {
+            for (auto it = begin_dfs_scan(); it != end_dfs_scan(); ++it) rewrite(i++, (*it)->data);
+        }
+        ++changes;
+    }
+
     void myHeap() { // Custom heap operation
+        unshare_all();
         myHeapHelper(root);
+        ++changes;
+    }
+
+    std::size_t compact(Order order = Order::DFS) { // Copies the tree into one contiguous block laid out in the given order
+        if (!root) return 0;
+        std::size_t before = footprint();
+
+        std::vector<std::pair<Node<T>*, std::size_t>> layout; // Old node and the layout index of its parent
+        if (order == Order::BFS) {
+            layout.emplace_back(root.get(), 0);
+            for (std::size_t i = 0; i < layout.size(); ++i) {
+                for (const auto& child : layout[i].first->children) {
+                    layout.emplace_back(child.get(), i); // Children of a node end up next to each other
+                }
+            }
+        } else {
+            std::stack<std::pair<Node<T>*, std::size_t>> pending;
+            pending.push(std::make_pair(root.get(), std::size_t(0)));
+            while (!pending.empty()) {
+                auto current = pending.top();
+                pending.pop();
+                std::size_t index = layout.size();
+                layout.push_back(current);
+                auto& children = current.first->children;
+                for (auto it = children.rbegin(); it != children.rend(); ++it) {
+                    pending.push(std::make_pair(it->get(), index)); // Push the children in reverse order
+                }
+            }
+        }
+
+        auto block = std::make_shared<std::vector<Node<T>>>();
+        TREE_COUNT(stats_pointer(), allocations, 1);
+        block->reserve(layout.size()); // Never reallocates, so node addresses stay stable
+        for (const auto& entry : layout) {
+            block->emplace_back(entry.first->data);
+            block->back().children.reserve(entry.first->children.size());
+        }
+        adopt_arena(block, [&layout](std::size_t i) { return layout[i].second; });
+        ++changes; // Same values, but every node moved
+        std::size_t after = footprint();
+        return before > after ? before - after : 0; // Bytes reclaimed
+    }
+
+    template <typename Parents, typename Value>
+    void assign(const Parents& parents, Value&& value_of) { // Replaces the tree with parents.size() nodes in one contiguous
+        // block, in index order. Node i holds value_of(i), called once per node in order, and is the next child of node
+        // parents[i], which must come before it. parents[0] is ignored, node 0 is the root.
+        std::size_t count = parents.size();
+        std::vector<unsigned> child_counts(count, 0);
+        for (std::size_t i = 1; i < count; ++i) {
+            if (std::size_t(parents[i]) >= i) {
+                throw std::runtime_error("Parent must come before its child");
+            }
+            if (++child_counts[parents[i]] > unsigned(K)) {
+                throw std::runtime_error("Parent has more than K children");
+            }
+        }
+        ++changes;
+        if (count == 0) {
+            root = nullptr;
+            arena = nullptr;
+            return;
+        }
+
+        auto block = std::make_shared<std::vector<Node<T>>>();
+        TREE_COUNT(stats_pointer(), allocations, 1);
+        block->reserve(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            block->emplace_back(value_of(i));
+            if (child_counts[i] > 0) block->back().children.reserve(child_counts[i]);
+        }
+        adopt_arena(block, [&parents](std::size_t i) { return std::size_t(parents[i]); });
     }
 
     // Pre-Order Iterator (Binary Tree)
     class BinaryPreOrderIterator : public BinaryTreeIterator<T> {
     public:
-        BinaryPreOrderIterator(std::shared_ptr<Node<T>> root) {
+        BinaryPreOrderIterator(std::shared_ptr<Node<T>> root, TreeStats* stats = nullptr) {
+            this->attach(stats);
+            this->_current = root; // Start at the root, its children are pushed by the first increment
+            TREE_COUNT(stats, pointer_copies, 1);
             if (root) {
-                this->_node_stack.push(root); // Push the root node to the stack
-                this->_current = root; // Set the current node to root
+                TREE_COUNT(stats, traversals, 1);
+                TREE_COUNT(stats, nodes_visited, 1);
             }
         }
 
@@ -156,10 +779,13 @@ public:
             for (auto it = this->_current->children.rbegin(); it != this->_current->children.rend(); ++it) {
                 this->_node_stack.push(*it); // Push the children in reverse order
             }
+            TREE_COUNT(this->_stats, pointer_copies, this->_current->children.size());
 
             if (!this->_node_stack.empty()) {
                 this->_current = this->_node_stack.top(); // Set the current node to the top of the stack
                 this->_node_stack.pop();
+                TREE_COUNT(this->_stats, pointer_copies, 1);
+                TREE_COUNT(this->_stats, nodes_visited, 1);
             } else {
                 this->_current = nullptr; // No more nodes to visit
             }
@@ -183,12 +809,16 @@ public:
     // In-Order Iterator (Binary Tree)
     class BinaryInOrderIterator : public BinaryTreeIterator<T> {
     public:
-        BinaryInOrderIterator(std::shared_ptr<Node<T>> root) {
+        BinaryInOrderIterator(std::shared_ptr<Node<T>> root, TreeStats* stats = nullptr) {
+            this->attach(stats);
             if (root) {
                 this->traverse_left(root); // Traverse to the leftmost node
                 if (!this->_node_stack.empty()) {
                     this->_current = this->_node_stack.top(); // Set the current node to the top of the stack
                     this->_node_stack.pop();
+                    TREE_COUNT(stats, pointer_copies, 1);
+                    TREE_COUNT(stats, traversals, 1);
+                    TREE_COUNT(stats, nodes_visited, 1);
                 }
             }
         }
@@ -203,6 +833,8 @@ public:
             if (!this->_node_stack.empty()) {
                 this->_current = this->_node_stack.top(); // Set the current node to the top of the stack
                 this->_node_stack.pop();
+                TREE_COUNT(this->_stats, pointer_copies, 1);
+                TREE_COUNT(this->_stats, nodes_visited, 1);
             } else {
                 this->_current = nullptr; // No more nodes to visit
             }
@@ -226,12 +858,16 @@ public:
     // Post-Order Iterator (Binary Tree)
     class BinaryPostOrderIterator : public BinaryTreeIterator<T> {
     public:
-        BinaryPostOrderIterator(std::shared_ptr<Node<T>> root) {
+        BinaryPostOrderIterator(std::shared_ptr<Node<T>> root, TreeStats* stats = nullptr) {
+            this->attach(stats);
             if (root) {
                 traverse_post_order(root); // Traverse in post-order
                 if (!this->_node_stack.empty()) {
                     this->_current = this->_node_stack.top(); // Set the current node to the top of the stack
                     this->_node_stack.pop();
+                    TREE_COUNT(stats, pointer_copies, 1);
+                    TREE_COUNT(stats, traversals, 1);
+                    TREE_COUNT(stats, nodes_visited, 1);
                 }
             }
         }
@@ -242,6 +878,8 @@ public:
             if (!this->_node_stack.empty()) {
                 this->_current = this->_node_stack.top(); // Set the current node to the top of the stack
                 this->_node_stack.pop();
+                TREE_COUNT(this->_stats, pointer_copies, 1);
+                TREE_COUNT(this->_stats, nodes_visited, 1);
             } else {
                 this->_current = nullptr; // No more nodes to visit
             }
@@ -265,6 +903,7 @@ public:
         void traverse_post_order(std::shared_ptr<Node<T>> node) { // Helper function for post-order traversal
             std::stack<std::shared_ptr<Node<T>>> temp_stack;
             temp_stack.push(node);
+            TREE_COUNT(this->_stats, pointer_copies, 1);
 
             while (!temp_stack.empty()) {
                 auto current = temp_stack.top(); // Get the top node
@@ -274,6 +913,7 @@ public:
                 for (const auto& child : current->children) {
                     temp_stack.push(child); // Push the children
                 }
+                TREE_COUNT(this->_stats, pointer_copies, 2 + current->children.size());
             }
         }
     };
@@ -283,11 +923,15 @@ public:
     private:
         std::stack<std::shared_ptr<Node<T>>> nodes; // Stack for DFS
     public:
-        DFSIterator(std::shared_ptr<Node<T>> root) {
+        DFSIterator(std::shared_ptr<Node<T>> root, TreeStats* stats = nullptr) {
+            this->attach(stats);
             if (root) nodes.push(root);
             if (!nodes.empty()) {
                 this->_current = nodes.top(); // Set the current node to the top of the stack
                 nodes.pop();
+                TREE_COUNT(stats, pointer_copies, 2);
+                TREE_COUNT(stats, traversals, 1);
+                TREE_COUNT(stats, nodes_visited, 1);
             }
         }
 
@@ -299,10 +943,13 @@ public:
             for (auto it = this->_current->children.rbegin(); it != this->_current->children.rend(); ++it) {
                 nodes.push(*it); // Push the children in reverse order
             }
+            TREE_COUNT(this->_stats, pointer_copies, this->_current->children.size());
 
             if (!nodes.empty()) {
                 this->_current = nodes.top(); // Set the current node to the top of the stack
                 nodes.pop();
+                TREE_COUNT(this->_stats, pointer_copies, 1);
+                TREE_COUNT(this->_stats, nodes_visited, 1);
             } else {
                 this->_current = nullptr; // No more nodes to visit
             }
@@ -328,11 +975,15 @@ public:
     private:
         std::queue<std::shared_ptr<Node<T>>> nodes; // Queue for BFS
     public:
-        BFSIterator(std::shared_ptr<Node<T>> root) {
+        BFSIterator(std::shared_ptr<Node<T>> root, TreeStats* stats = nullptr) {
+            this->attach(stats);
             if (root) nodes.push(root);
             if (!nodes.empty()) {
                 this->_current = nodes.front(); // Set the current node to the front of the queue
                 nodes.pop();
+                TREE_COUNT(stats, pointer_copies, 2);
+                TREE_COUNT(stats, traversals, 1);
+                TREE_COUNT(stats, nodes_visited, 1);
             }
         }
 
@@ -344,10 +995,13 @@ public:
             for (const auto& child : this->_current->children) {
                 nodes.push(child); // Enqueue the children
             }
+            TREE_COUNT(this->_stats, pointer_copies, this->_current->children.size());
 
             if (!nodes.empty()) {
                 this->_current = nodes.front(); // Set the current node to the front of the queue
                 nodes.pop();
+                TREE_COUNT(this->_stats, pointer_copies, 1);
+                TREE_COUNT(this->_stats, nodes_visited, 1);
             } else {
                 this->_current = nullptr; // No more nodes to visit
             }
@@ -370,7 +1024,7 @@ public:
 
     // Functions to get the beginning and end iterators for various traversal methods
     BinaryPreOrderIterator begin_pre_order() const {
-        return BinaryPreOrderIterator(root);
+        return BinaryPreOrderIterator(root, stats_pointer());
     }
 
     BinaryPreOrderIterator end_pre_order() const {
@@ -378,7 +1032,7 @@ public:
     }
 
     BinaryInOrderIterator begin_in_order() const {
-        return BinaryInOrderIterator(root);
+        return BinaryInOrderIterator(root, stats_pointer());
     }
 
     BinaryInOrderIterator end_in_order() const {
@@ -386,7 +1040,7 @@ public:
     }
 
     BinaryPostOrderIterator begin_post_order() const {
-        return BinaryPostOrderIterator(root);
+        return BinaryPostOrderIterator(root, stats_pointer());
     }
 
     BinaryPostOrderIterator end_post_order() const {
@@ -394,7 +1048,7 @@ public:
     }
 
     BFSIterator begin_bfs_scan() const {
-        return BFSIterator(root);
+        return BFSIterator(root, stats_pointer());
     }
 
     BFSIterator end_bfs_scan() const {
@@ -402,7 +1056,7 @@ public:
     }
 
     DFSIterator begin_dfs_scan() const {
-        return DFSIterator(root);
+        return DFSIterator(root, stats_pointer());
     }
 
     DFSIterator end_dfs_scan() const {
@@ -0,0 +1,235 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "Complex.hpp"
+#include "Node.hpp"
+#include "Tree.hpp"
+
+enum class Traversal { PreOrder, InOrder, PostOrder, BFS, DFS };
+
+// Growable output buffer that formats numbers with std::to_chars: no locale, no stream state, no flush per value.
+class TextBuffer {
+public:
+    explicit TextBuffer(int precision = -1, std::size_t capacity = 1 << 16) // precision < 0 prints the shortest exact form
+        : buffer(new char[capacity]), used(0), capacity(capacity), digits(precision) {}
+
+    void append(const char* text, std::size_t length) {
+        std::memcpy(reserve(length), text, length);
+        used += length;
+    }
+
+    void append(const std::string& text) {
+        append(text.data(), text.size());
+    }
+
+    void append(const char* text) {
+        append(text, std::strlen(text));
+    }
+
+    void append(char c) {
+        *reserve(1) = c;
+        ++used;
+    }
+
+    template <typename N>
+    typename std::enable_if<std::is_arithmetic<N>::value>::type append(N value) {
+        std::size_t room = std::is_floating_point<N>::value ? 32 + (digits > 0 ? digits : 0) : 24;
+        char* first = reserve(room);
+        used = format(first, first + room, value) - buffer.get();
+    }
+
+    template <typename F>
+    void append(const BasicComplex<F>& value) { // Same layout as operator<<
+        append(value.getReal());
+        append(" + ", 3);
+        append(value.getImag());
+        append('i');
+    }
+
+    template <typename T>
+    typename std::enable_if<!std::is_arithmetic<T>::value>::type append(const T& value) { // Any other streamable type
+        std::ostringstream text;
+        text << value;
+        append(text.str());
+    }
+
+    int precision() const {
+        return digits;
+    }
+
+    void set_precision(int precision) {
+        digits = precision;
+    }
+
+    const char* data() const {
+        return buffer.get();
+    }
+
+    std::size_t size() const {
+        return used;
+    }
+
+    void clear() {
+        used = 0;
+    }
+
+    void write_to(std::ostream& os) { // One write for everything appended so far, then empties the buffer
+        os.write(buffer.get(), used);
+        used = 0;
+    }
+
+private:
+    std::unique_ptr<char[]> buffer;
+    std::size_t used;
+    std::size_t capacity;
+    int digits;
+
+    char* reserve(std::size_t extra) { // Grows geometrically so appends stay amortised O(1)
+        if (used + extra > capacity) {
+            std::size_t grown = std::max(2 * capacity, used + extra);
+            std::unique_ptr<char[]> larger(new char[grown]);
+            std::memcpy(larger.get(), buffer.get(), used);
+            buffer.swap(larger);
+            capacity = grown;
+        }
+        return buffer.get() + used;
+    }
+
+    template <typename N>
+    typename std::enable_if<std::is_floating_point<N>::value, char*>::type format(char* first, char* last, N value) const {
+        if (digits < 0) return std::to_chars(first, last, value).ptr;
+        char* end = format_fixed(first, double(value));
+        return end ? end : std::to_chars(first, last, value, std::chars_format::general, digits).ptr;
+    }
+
+    // Integer fast path for the fixed notation cases of chars_format::general with at most 9 digits. Returns nullptr,
+    // leaving the value to to_chars, when the value needs an exponent or is too close to a rounding tie to be sure.
+    char* format_fixed(char* out, double value) const {
+        static const double powers[] = {1e-4, 1e-3, 1e-2, 1e-1, 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+                                        1e10, 1e11, 1e12}; // powers[k + 4] == 10^k
+        if (digits < 1 || digits > 9) return nullptr;
+        double magnitude = value < 0 ? -value : value;
+        if (!(magnitude >= 1e-4 && magnitude < powers[digits + 4])) return nullptr; // Also rejects zero and NaN
+        int exponent = -4;
+        while (exponent + 1 < digits && magnitude >= powers[exponent + 5]) ++exponent;
+        double scaled = magnitude * powers[digits - 1 - exponent + 4]; // Exact power of ten, one rounding step
+        double whole = double((unsigned long long)scaled);
+        double fraction = scaled - whole;
+        if (fraction > 0.5 - 1e-6 && fraction < 0.5 + 1e-6) return nullptr;
+        unsigned long long significand = (unsigned long long)whole + (fraction > 0.5 ? 1 : 0);
+        if (significand < (unsigned long long)powers[digits + 3] || significand >= (unsigned long long)powers[digits + 4]) {
+            return nullptr; // Exponent guessed wrong or rounding carried into another digit
+        }
+
+        char text[9];
+        for (int i = digits - 1; i >= 0; --i, significand /= 10) text[i] = char('0' + significand % 10);
+        int integer_digits = exponent >= 0 ? exponent + 1 : 0;
+        int length = digits;
+        while (length > integer_digits && text[length - 1] == '0') --length; // %g drops trailing zeros
+
+        if (value < 0) *out++ = '-';
+        if (integer_digits > 0) {
+            std::memcpy(out, text, integer_digits);
+            out += integer_digits;
+        } else {
+            *out++ = '0';
+        }
+        if (length > integer_digits) {
+            *out++ = '.';
+            for (int i = exponent + 1; i < 0; ++i) *out++ = '0';
+            std::memcpy(out, text + integer_digits, length - integer_digits);
+            out += length - integer_digits;
+        }
+        return out;
+    }
+
+    template <typename N>
+    typename std::enable_if<std::is_integral<N>::value, char*>::type format(char* first, char* last, N value) const {
+        return std::to_chars(first, last, value).ptr;
+    }
+
+    char* format(char* first, char*, bool value) const {
+        *first = value ? '1' : '0';
+        return first + 1;
+    }
+};
+
+// How a value of type T is written as text by dump, the exporters and the renderer. The default uses
+// TextBuffer::append; specialise it to give a type its own label.
+template <typename T>
+struct TextFormat {
+    static void write(TextBuffer& out, const T& value) {
+        out.append(value);
+    }
+};
+
+// Formats every value of a traversal into buffer, separator after each, without touching the node reference counts.
+// The orders match the Tree iterators: InOrder and PostOrder follow the binary iterators, PreOrder and DFS coincide.
+template <typename T, int K>
+void dump(const Tree<T, K>& tree, Traversal order, TextBuffer& buffer, char separator = '\n') {
+    const Node<T>* root = tree.get_root().get();
+    if (!root) return;
+    std::vector<const Node<T>*> pending(1, root);
+    if (order == Traversal::BFS) {
+        for (std::size_t i = 0; i < pending.size(); ++i) {
+            TextFormat<T>::write(buffer, pending[i]->data);
+            buffer.append(separator);
+            for (const auto& child : pending[i]->children) {
+                pending.push_back(child.get());
+            }
+        }
+    } else if (order == Traversal::InOrder) {
+        pending.clear();
+        const Node<T>* current = root;
+        while (current || !pending.empty()) {
+            for (; current; current = current->children.empty() ? nullptr : current->children[0].get()) {
+                pending.push_back(current);
+            }
+            current = pending.back();
+            pending.pop_back();
+            TextFormat<T>::write(buffer, current->data);
+            buffer.append(separator);
+            current = current->children.size() > 1 ? current->children[1].get() : nullptr;
+        }
+    } else if (order == Traversal::PostOrder) {
+        std::vector<const Node<T>*> reversed; // Root, last child first, printed backwards
+        while (!pending.empty()) {
+            const Node<T>* current = pending.back();
+            pending.pop_back();
+            reversed.push_back(current);
+            for (const auto& child : current->children) {
+                pending.push_back(child.get());
+            }
+        }
+        for (auto it = reversed.rbegin(); it != reversed.rend(); ++it) {
+            TextFormat<T>::write(buffer, (*it)->data);
+            buffer.append(separator);
+        }
+    } else {
+        while (!pending.empty()) {
+            const Node<T>* current = pending.back();
+            pending.pop_back();
+            TextFormat<T>::write(buffer, current->data);
+            buffer.append(separator);
+            for (auto it = current->children.rbegin(); it != current->children.rend(); ++it) {
+                pending.push_back(it->get());
+            }
+        }
+    }
+}
+
+template <typename T, int K>
+void dump(std::ostream& os, const Tree<T, K>& tree, Traversal order, int precision = -1, char separator = '\n') {
+    TextBuffer buffer(precision);
+    dump(tree, order, buffer, separator);
+    buffer.write_to(os); // The whole traversal in one write
+}
@@ -0,0 +1,300 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "Node.hpp"
+#include "Tree.hpp"
+#include "TreeDump.hpp"
+#include "TreeLayout.hpp"
+
+// How a tree is drawn by write_svg and write_ppm, in pixels. When max_width or max_height is set and the drawing
+// would be larger, everything is scaled down by the same factor to fit.
+struct ExportStyle {
+    double node_distance = 50; // Horizontal distance between neighbouring nodes
+    double level_distance = 50; // Vertical distance between rows
+    double radius = 15; // Node circle radius
+    double max_width = 0; // 0 for no limit
+    double max_height = 0;
+    bool labels = true;
+    int precision = -1; // Label digits, as for TextBuffer
+};
+
+// Pixel geometry shared by both formats: where entry x and depth land once margins and scaling are applied.
+class ExportFrame {
+public:
+    template <typename T>
+    ExportFrame(const TreeLayout<T>& layout, const ExportStyle& style) : scale(1) {
+        double margin = style.radius + 2;
+        double levels = layout.level_count() > 0 ? double(layout.level_count() - 1) : 0;
+        double natural_width = layout.width() * style.node_distance + 2 * margin;
+        double natural_height = levels * style.level_distance + 2 * margin;
+        if (style.max_width > 0 && natural_width > style.max_width) scale = style.max_width / natural_width;
+        if (style.max_height > 0 && natural_height * scale > style.max_height) scale = style.max_height / natural_height;
+        this->margin = margin * scale;
+        node_distance = style.node_distance * scale;
+        level_distance = style.level_distance * scale;
+        radius = style.radius * scale;
+        width = std::max<std::size_t>(1, std::size_t(std::ceil(natural_width * scale)));
+        height = std::max<std::size_t>(1, std::size_t(std::ceil(natural_height * scale)));
+    }
+
+    double x(double layout_x) const {
+        return margin + layout_x * node_distance;
+    }
+
+    double y(std::size_t depth) const {
+        return margin + depth * level_distance;
+    }
+
+    double scale, margin, node_distance, level_distance, radius;
+    std::size_t width, height; // Image size
+};
+
+// Horizontal strip of an RGB image. write_ppm renders one strip at a time and streams it out, so the memory used is
+// the strip, not the picture.
+class RasterBand {
+public:
+    struct Color {
+        unsigned char r, g, b;
+    };
+
+    RasterBand(std::size_t width, std::size_t rows) : width(width), rows(rows), top(0), pixels(width * rows * 3) {}
+
+    void reset(std::size_t top, std::size_t rows) { // Moves the strip to image rows [top, top + rows), all white
+        this->top = top;
+        this->rows = rows;
+        std::fill(pixels.begin(), pixels.begin() + width * rows * 3, (unsigned char)255);
+    }
+
+    void write_to(std::ostream& os) const {
+        os.write(reinterpret_cast<const char*>(pixels.data()), std::streamsize(width * rows * 3));
+    }
+
+    void span(long y, long x0, long x1, Color color) { // Fills pixels x0..x1 of image row y, clipped to the strip
+        if (y < long(top) || y >= long(top + rows)) return;
+        x0 = std::max(x0, 0L);
+        x1 = std::min(x1, long(width) - 1);
+        if (x0 > x1) return;
+        unsigned char* p = &pixels[((y - top) * width + x0) * 3];
+        for (long x = x0; x <= x1; ++x, p += 3) {
+            p[0] = color.r;
+            p[1] = color.g;
+            p[2] = color.b;
+        }
+    }
+
+    void segment(double x0, double y0, double x1, double y1, Color color) { // One pixel wide, y0 <= y1
+        long first = std::max(long(std::floor(y0)), long(top));
+        long last = std::min(long(std::floor(y1)), long(top + rows) - 1);
+        if (y1 <= y0) {
+            span(long(std::floor(y0)), long(std::floor(std::min(x0, x1))), long(std::floor(std::max(x0, x1))), color);
+            return;
+        }
+        double slope = (x1 - x0) / (y1 - y0);
+        for (long y = first; y <= last; ++y) { // The part of the segment inside each row
+            double xa = x0 + (std::max(double(y), y0) - y0) * slope;
+            double xb = x0 + (std::min(double(y + 1), y1) - y0) * slope;
+            span(y, long(std::floor(std::min(xa, xb))), long(std::floor(std::max(xa, xb))), color);
+        }
+    }
+
+    void disc(double cx, double cy, double r, Color color) {
+        if (r < 1) { // Too small to have a pixel centre inside, keep it visible as one pixel
+            span(long(std::floor(cy)), long(std::floor(cx)), long(std::floor(cx)), color);
+            return;
+        }
+        long first = std::max(long(std::floor(cy - r)), long(top));
+        long last = std::min(long(std::floor(cy + r)), long(top + rows) - 1);
+        for (long y = first; y <= last; ++y) {
+            double dy = y + 0.5 - cy;
+            if (dy * dy > r * r) continue;
+            double half = std::sqrt(r * r - dy * dy);
+            span(y, long(std::ceil(cx - half - 0.5)), long(std::floor(cx + half - 0.5)), color);
+        }
+    }
+
+    void text(const char* text, std::size_t length, double cx, double cy, long size, Color color) { // Centred
+        long advance = 4 * size;
+        long x = long(std::lround(cx - (advance * long(length) - size) / 2.0));
+        long y = long(std::lround(cy - 2.5 * size));
+        if (y + 5 * size <= long(top) || y >= long(top + rows)) return;
+        for (std::size_t i = 0; i < length; ++i, x += advance) {
+            unsigned bits = glyph(text[i]);
+            for (int row = 0; row < 5; ++row) {
+                for (int column = 0; column < 3; ++column) {
+                    if (!(bits >> (14 - 3 * row - column) & 1)) continue;
+                    for (long dy = 0; dy < size; ++dy) {
+                        span(y + row * size + dy, x + column * size, x + (column + 1) * size - 1, color);
+                    }
+                }
+            }
+        }
+    }
+
+private:
+    std::size_t width, rows, top;
+    std::vector<unsigned char> pixels;
+
+    static unsigned glyph(char c) { // 3x5 bitmap, rows top to bottom, 3 bits each with the left column highest
+        static const unsigned digits[] = {0x7B6F, 0x2C97, 0x73E7, 0x73CF, 0x5BC9, 0x79CF, 0x79EF, 0x7249, 0x7BEF, 0x7BCF};
+        if (c >= '0' && c <= '9') return digits[c - '0'];
+        switch (c) {
+            case '.': return 0x0002;
+            case '-': return 0x01C0;
+            case '+': return 0x05D0;
+            case 'i': return 0x2092;
+            case 'e': return 0x7BE7;
+            default: return 0; // Blank for anything the numbers do not need
+        }
+    }
+};
+
+// Writes text with the XML special characters escaped.
+inline void append_escaped(TextBuffer& out, const char* text, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i) {
+        switch (text[i]) {
+            case '<': out.append("&lt;", 4); break;
+            case '>': out.append("&gt;", 4); break;
+            case '&': out.append("&amp;", 5); break;
+            case '"': out.append("&quot;", 6); break;
+            default: out.append(text[i]);
+        }
+    }
+}
+
+// Streams a laid out tree as SVG: one path per batch of edges, then the circles, then the labels. The text goes
+// through a TextBuffer that is written out whenever it fills, so memory stays bounded however many nodes there are.
+template <typename T>
+void write_svg(std::ostream& os, const TreeLayout<T>& layout, const ExportStyle& style = ExportStyle()) {
+    const std::size_t flush_size = 1 << 16;
+    ExportFrame frame(layout, style);
+    const auto& entries = layout.entries();
+    TextBuffer out(9); // Coordinates
+    TextBuffer label(style.precision);
+
+    out.append("<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"");
+    out.append(frame.width);
+    out.append("\" height=\"");
+    out.append(frame.height);
+    out.append("\" viewBox=\"0 0 ");
+    out.append(frame.width);
+    out.append(' ');
+    out.append(frame.height);
+    out.append("\">\n<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n<g stroke=\"red\" fill=\"none\">\n");
+    for (std::size_t i = 1; i < entries.size(); ++i) {
+        if (i % 1024 == 1) out.append("<path d=\"");
+        const auto& parent = entries[entries[i].parent];
+        out.append('M');
+        out.append(frame.x(parent.x));
+        out.append(' ');
+        out.append(frame.y(parent.depth));
+        out.append('L');
+        out.append(frame.x(entries[i].x));
+        out.append(' ');
+        out.append(frame.y(entries[i].depth));
+        if (i % 1024 == 0 || i + 1 == entries.size()) out.append("\"/>\n");
+        if (out.size() > flush_size) out.write_to(os);
+    }
+    out.append("</g>\n<g fill=\"white\" stroke=\"black\">\n");
+    for (const auto& entry : entries) {
+        out.append("<circle cx=\"");
+        out.append(frame.x(entry.x));
+        out.append("\" cy=\"");
+        out.append(frame.y(entry.depth));
+        out.append("\" r=\"");
+        out.append(frame.radius);
+        out.append("\"/>\n");
+        if (out.size() > flush_size) out.write_to(os);
+    }
+    out.append("</g>\n");
+    if (style.labels) {
+        out.append("<g font-family=\"sans-serif\" font-size=\"");
+        out.append(12 * frame.scale);
+        out.append("\" text-anchor=\"middle\" dominant-baseline=\"central\">\n");
+        for (const auto& entry : entries) {
+            out.append("<text x=\"");
+            out.append(frame.x(entry.x));
+            out.append("\" y=\"");
+            out.append(frame.y(entry.depth));
+            out.append("\">");
+            label.clear();
+            TextFormat<T>::write(label, entry.node->data);
+            append_escaped(out, label.data(), label.size());
+            out.append("</text>\n");
+            if (out.size() > flush_size) out.write_to(os);
+        }
+        out.append("</g>\n");
+    }
+    out.append("</svg>\n");
+    out.write_to(os);
+}
+
+// Streams a laid out tree as a binary PPM (P6) image, rendered in strips of rows top to bottom. Labels use a built-in
+// 3x5 pixel font, so no font file is needed; they are left out when the circles are too small to hold them.
+template <typename T>
+void write_ppm(std::ostream& os, const TreeLayout<T>& layout, const ExportStyle& style = ExportStyle()) {
+    const std::size_t band_rows = 64;
+    const RasterBand::Color red = {255, 0, 0}, white = {255, 255, 255}, black = {0, 0, 0};
+    ExportFrame frame(layout, style);
+    const auto& entries = layout.entries();
+    std::size_t levels = layout.level_count();
+    double r = frame.radius;
+    long text_size = std::max(1L, long(r / 10));
+    bool labels = style.labels && r >= 5;
+    TextBuffer label(style.precision);
+
+    TextBuffer header;
+    header.append("P6\n");
+    header.append(frame.width);
+    header.append(' ');
+    header.append(frame.height);
+    header.append("\n255\n");
+    header.write_to(os);
+
+    RasterBand band(frame.width, band_rows);
+    for (std::size_t top = 0; top < frame.height; top += band_rows) {
+        std::size_t rows = std::min(band_rows, frame.height - top);
+        band.reset(top, rows);
+        if (levels > 0) {
+            // Rows whose circles reach into the strip; edges ending on the row below may cross it as well
+            double from = std::floor((double(top) - r - frame.margin) / frame.level_distance);
+            double to = std::ceil((double(top + rows) + r - frame.margin) / frame.level_distance);
+            std::size_t first = from > 0 ? std::size_t(from) : 0;
+            std::size_t last = to > 0 ? std::min(std::size_t(to), levels - 1) : 0;
+            for (std::size_t depth = std::max<std::size_t>(first, 1); depth <= std::min(last + 1, levels - 1); ++depth) {
+                for (std::size_t i = layout.level_begin(depth); i < layout.level_begin(depth + 1); ++i) {
+                    const auto& parent = entries[entries[i].parent];
+                    band.segment(frame.x(parent.x), frame.y(parent.depth), frame.x(entries[i].x), frame.y(depth), red);
+                }
+            }
+            for (std::size_t depth = first; depth <= last; ++depth) {
+                for (std::size_t i = layout.level_begin(depth); i < layout.level_begin(depth + 1); ++i) {
+                    band.disc(frame.x(entries[i].x), frame.y(depth), r, black);
+                    if (r >= 2) band.disc(frame.x(entries[i].x), frame.y(depth), r - 1, white);
+                }
+            }
+            for (std::size_t depth = first; labels && depth <= last; ++depth) {
+                for (std::size_t i = layout.level_begin(depth); i < layout.level_begin(depth + 1); ++i) {
+                    label.clear();
+                    TextFormat<T>::write(label, entries[i].node->data);
+                    band.text(label.data(), label.size(), frame.x(entries[i].x), frame.y(depth), text_size, black);
+                }
+            }
+        }
+        band.write_to(os);
+    }
+}
+
+template <typename T, int K>
+void write_svg(std::ostream& os, const Tree<T, K>& tree, const ExportStyle& style = ExportStyle()) {
+    write_svg(os, TreeLayout<T>(tree), style);
+}
+
+template <typename T, int K>
+void write_ppm(std::ostream& os, const Tree<T, K>& tree, const ExportStyle& style = ExportStyle()) {
+    write_ppm(os, TreeLayout<T>(tree), style);
+}
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+#include "Complex.hpp"
+#include "Tree.hpp"
+
+enum class Shape {
+    Complete, // Every level full except the last, filled left to right
+    RandomRecursive, // Each node joins a uniformly chosen earlier node that still has room
+    PreferentialAttachment, // Like RandomRecursive, weighted by one plus the number of children, so a few hubs emerge
+    Caterpillar, // A chain of spine nodes, each with K - 1 leaves
+    DeepChain // A single path, depth equals size - 1
+};
+
+enum class Values {
+    Sequential, // The node's index, in creation order
+    Uniform, // Uniform in [low, high)
+    Normal // Mean (low + high) / 2, standard deviation (high - low) / 6
+};
+
+// What generate_tree() builds. The same spec builds the same tree on every platform.
+struct WorkloadSpec {
+    std::size_t nodes = 1000;
+    Shape shape = Shape::Complete;
+    Values values = Values::Uniform;
+    double low = -100;
+    double high = 100;
+    std::uint64_t seed = 1;
+};
+
+// splitmix64: one word of state, and unlike the std distributions the same numbers with every standard library.
+class WorkloadRandom {
+public:
+    explicit WorkloadRandom(std::uint64_t seed) : state(seed), spare(0), has_spare(false) {}
+
+    std::uint64_t next() {
+        std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+    std::uint32_t below(std::uint32_t n) { // Uniform in [0, n), by multiplication instead of a division
+        return std::uint32_t(((next() >> 32) * n) >> 32);
+    }
+
+    double uniform() { // Uniform in [0, 1)
+        return double(next() >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    double normal() { // Standard normal, Box-Muller in pairs
+        if (has_spare) {
+            has_spare = false;
+            return spare;
+        }
+        double radius = std::sqrt(-2 * std::log(1 - uniform())); // 1 - uniform() is never 0
+        double angle = 6.283185307179586 * uniform();
+        spare = radius * std::sin(angle);
+        has_spare = true;
+        return radius * std::cos(angle);
+    }
+
+private:
+    std::uint64_t state;
+    double spare;
+    bool has_spare;
+};
+
+// Draws the numbers node values are made of, in node order.
+class WorkloadValueSource {
+public:
+    explicit WorkloadValueSource(const WorkloadSpec& spec)
+        : values(spec.values), low(spec.low), high(spec.high), random(spec.seed ^ 0x5851f42d4c957f2dull) {}
+
+    double draw(std::size_t index) { // Values have their own stream, so a seed gives the same values for every shape
+        switch (values) {
+            case Values::Sequential:
+                return double(index);
+            case Values::Uniform:
+                return low + (high - low) * random.uniform();
+            case Values::Normal:
+                return (low + high) / 2 + (high - low) / 6 * random.normal();
+        }
+        return 0;
+    }
+
+private:
+    Values values;
+    double low;
+    double high;
+    WorkloadRandom random;
+};
+
+// How generated numbers become a value of type T. Specialize it to generate trees of other value types.
+template <typename T>
+struct WorkloadValue;
+
+template <>
+struct WorkloadValue<double> {
+    static double make(WorkloadValueSource& source, std::size_t index) {
+        return source.draw(index);
+    }
+};
+
+template <>
+struct WorkloadValue<Complex> {
+    static Complex make(WorkloadValueSource& source, std::size_t index) { // Real and imaginary parts drawn independently
+        double real = source.draw(index);
+        return Complex(real, source.draw(index));
+    }
+};
+
+// The parent of every node of a tree with the given shape and at most arity children per node, in creation order.
+// parents[0] is 0 and every other parent comes before its child, as Tree::assign() expects.
+inline std::vector<std::uint32_t> workload_parents(const WorkloadSpec& spec, std::size_t arity) {
+    if (spec.nodes > std::numeric_limits<std::uint32_t>::max()) {
+        throw std::runtime_error("Too many nodes for a generated tree");
+    }
+    if (arity == 0 && spec.nodes > 1) {
+        throw std::runtime_error("Nodes without children cannot form a tree");
+    }
+    std::uint32_t count = std::uint32_t(spec.nodes);
+    std::vector<std::uint32_t> parents(count, 0);
+    WorkloadRandom random(spec.seed);
+
+    switch (spec.shape) {
+        case Shape::Complete:
+            for (std::uint32_t i = 1; i < count; ++i) parents[i] = std::uint32_t((i - 1) / arity);
+            break;
+        case Shape::RandomRecursive: {
+            std::vector<std::uint32_t> open(1, 0); // Nodes with room for another child
+            std::vector<std::uint32_t> children(count, 0);
+            for (std::uint32_t i = 1; i < count; ++i) {
+                std::uint32_t slot = random.below(std::uint32_t(open.size()));
+                std::uint32_t parent = open[slot];
+                parents[i] = parent;
+                if (++children[parent] == arity) {
+                    open[slot] = open.back(); // Full, the order of open does not matter
+                    open.pop_back();
+                }
+                open.push_back(i);
+            }
+            break;
+        }
+        case Shape::PreferentialAttachment: {
+            std::vector<std::uint32_t> tickets(1, 0); // Each node once, plus once per child
+            std::vector<std::uint32_t> children(count, 0);
+            for (std::uint32_t i = 1; i < count; ) {
+                std::uint32_t slot = random.below(std::uint32_t(tickets.size()));
+                std::uint32_t parent = tickets[slot];
+                if (children[parent] == arity) { // Drawing a full node drops that ticket for good and draws again,
+                    tickets[slot] = tickets.back(); // which leaves the weights of the other nodes unchanged
+                    tickets.pop_back();
+                    continue;
+                }
+                parents[i] = parent;
+                ++children[parent];
+                tickets.push_back(parent);
+                tickets.push_back(i);
+                ++i;
+            }
+            break;
+        }
+        case Shape::Caterpillar: {
+            std::uint32_t spine = 0;
+            std::size_t legs = 0;
+            for (std::uint32_t i = 1; i < count; ++i) {
+                parents[i] = spine;
+                if (legs + 1 < arity) {
+                    ++legs;
+                } else { // The last child continues the spine
+                    spine = i;
+                    legs = 0;
+                }
+            }
+            break;
+        }
+        case Shape::DeepChain:
+            for (std::uint32_t i = 1; i < count; ++i) parents[i] = i - 1;
+            break;
+    }
+    return parents;
+}
+
+// Builds a tree straight into one contiguous block (see Tree::assign()), with nodes in creation order. Call
+// compact(Order::BFS) or compact(Order::DFS) afterwards to lay it out for a traversal.
+template <typename T, int K = 2>
+Tree<T, K> generate_tree(const WorkloadSpec& spec) {
+    Tree<T, K> tree;
+    {
+        std::vector<std::uint32_t> parents = workload_parents(spec, std::size_t(K));
+        WorkloadValueSource source(spec);
+        tree.assign(parents, [&source](std::size_t index) { return WorkloadValue<T>::make(source, index); });
+    }
+    return tree;
+}
@@ -0,0 +1,445 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+#include "Node.hpp"
+#include "Tree.hpp"
+
+// Tidy drawing of a tree (Reingold-Tilford, with Walker's apportioning in Buchheim et al.'s O(n) form): parents are
+// centred over their children and subtrees sit as close as they can without overlapping. x is in units of the node
+// distance with the leftmost node at 0, the depth is the row. Entries are stored flat in BFS order, so every row is a
+// contiguous run sorted by x.
+template <typename T>
+class TreeLayout {
+public:
+    static const std::size_t npos;
+
+    struct Entry {
+        const Node<T>* node;
+        std::size_t parent; // Entry index of the parent, npos for the root
+        double x;
+        std::size_t depth;
+    };
+
+    struct Subtree { // What lies below an entry, for culling and collapsing whole subtrees at once
+        std::size_t first_child; // Children are the entries [first_child, first_child + child_count)
+        std::size_t child_count;
+        double left, right; // x range of the subtree
+        std::size_t bottom; // Depth of its deepest row
+        std::size_t size; // Nodes in the subtree
+    };
+
+    TreeLayout() : root(npos), live_records(0), indexed(false), right(0) {}
+
+    template <int K>
+    explicit TreeLayout(const Tree<T, K>& tree) : TreeLayout() {
+        layout(tree);
+    }
+
+    template <int K>
+    void layout(const Tree<T, K>& tree) { // Full O(n) layout
+        states.clear();
+        free_ids.clear();
+        log.clear();
+        index.clear();
+        live_records = 0;
+        indexed = false;
+        root = npos;
+        if (tree.get_root()) {
+            root = allocate(tree.get_root().get(), npos, 0, 0);
+            mirror_children(root);
+            first_walk(root);
+        }
+        second_walk();
+    }
+
+    // Lays the tree out again after the subtree under handle changed shape or values, with everything outside that
+    // subtree unchanged. Only the subtree and the merges along its path to the root are redone; the final coordinate
+    // pass is a linear sweep over the flat array.
+    template <int K>
+    void relayout(const Tree<T, K>& tree, const std::shared_ptr<Node<T>>& handle) {
+        if (root == npos || !tree.get_root()) {
+            layout(tree);
+            return;
+        }
+        if (!indexed) build_index();
+        auto found = index.find(handle.get());
+        if (found == index.end()) {
+            throw std::invalid_argument("Node is not part of the laid out tree");
+        }
+        std::size_t changed = found->second;
+        std::vector<std::size_t> path; // Proper ancestors of changed, root first
+        for (std::size_t id = states[changed].parent; id != npos; id = states[id].parent) {
+            path.push_back(id);
+        }
+        std::reverse(path.begin(), path.end());
+        for (auto id : path) {
+            undo(id); // Root first: an ancestor always merged after its descendants
+        }
+        if (!refresh(tree.get_root().get(), path, changed)) {
+            layout(tree); // The shape changed outside the subtree after all
+            return;
+        }
+        release_descendants(changed);
+        mirror_children(changed);
+        first_walk(changed);
+        for (auto it = path.rbegin(); it != path.rend(); ++it) {
+            merge(*it);
+        }
+        if (log.size() > 2 * live_records + 1024) compact_log();
+        second_walk();
+    }
+
+    const std::vector<Entry>& entries() const {
+        return placed;
+    }
+
+    const std::vector<Subtree>& subtrees() const { // Parallel to entries()
+        return spans;
+    }
+
+    std::size_t size() const {
+        return placed.size();
+    }
+
+    std::size_t level_count() const { // Number of rows
+        return rows.empty() ? 0 : rows.size() - 1;
+    }
+
+    std::size_t level_begin(std::size_t depth) const { // Row depth is entries [level_begin(depth), level_begin(depth + 1))
+        return depth < rows.size() ? rows[depth] : placed.size();
+    }
+
+    double width() const { // x of the rightmost node
+        return right;
+    }
+
+private:
+    static constexpr double DISTANCE = 1.0; // Minimum horizontal gap between neighbouring nodes
+
+    struct State { // Walker's per-node fields, linked like the tree so ids stay stable across relayouts
+        const Node<T>* node;
+        std::size_t parent, first_child, last_child, prev_sibling, next_sibling;
+        std::size_t number; // Position among the siblings
+        std::size_t depth;
+        std::size_t thread; // Next contour node for leaves, set while merging an ancestor
+        std::size_t ancestor;
+        double prelim, mod, shift, change;
+        double midpoint; // Centre of the children once the node's own merge is done
+        std::size_t record_begin, record_end; // Writes of this node's merge in the log
+    };
+
+    struct Record { // A contour write made while merging, kept so the merge can be undone
+        std::size_t node;
+        bool thread; // Thread set (old mod kept), otherwise an ancestor change
+        std::size_t old_ancestor;
+        double old_mod;
+    };
+
+    std::vector<State> states;
+    std::vector<std::size_t> free_ids;
+    std::vector<Record> log;
+    std::unordered_map<const Node<T>*, std::size_t> index; // Built on the first relayout
+    std::size_t root;
+    std::size_t live_records;
+    bool indexed;
+    std::vector<Entry> placed;
+    std::vector<Subtree> spans;
+    std::vector<std::size_t> rows;
+    double right;
+
+    std::size_t allocate(const Node<T>* node, std::size_t parent, std::size_t number, std::size_t depth) {
+        std::size_t id;
+        if (free_ids.empty()) {
+            id = states.size();
+            states.push_back(State());
+        } else {
+            id = free_ids.back();
+            free_ids.pop_back();
+        }
+        State& s = states[id];
+        s.node = node;
+        s.parent = parent;
+        s.first_child = s.last_child = s.prev_sibling = s.next_sibling = npos;
+        s.number = number;
+        s.depth = depth;
+        s.record_begin = s.record_end = 0;
+        if (indexed) index[node] = id;
+        return id;
+    }
+
+    void mirror_children(std::size_t top) { // Links states for every node below top, allocated in BFS order
+        std::vector<std::size_t> pending(1, top);
+        for (std::size_t i = 0; i < pending.size(); ++i) {
+            std::size_t id = pending[i];
+            std::size_t previous = npos, number = 0;
+            for (const auto& child : states[id].node->children) {
+                std::size_t child_id = allocate(child.get(), id, number++, states[id].depth + 1);
+                states[child_id].prev_sibling = previous;
+                if (previous == npos) states[id].first_child = child_id; else states[previous].next_sibling = child_id;
+                previous = child_id;
+                pending.push_back(child_id);
+            }
+            states[id].last_child = previous;
+        }
+    }
+
+    void release_descendants(std::size_t top) {
+        std::vector<std::size_t> pending;
+        for (std::size_t child = states[top].first_child; child != npos; child = states[child].next_sibling) {
+            pending.push_back(child);
+        }
+        while (!pending.empty()) {
+            std::size_t id = pending.back();
+            pending.pop_back();
+            for (std::size_t child = states[id].first_child; child != npos; child = states[child].next_sibling) {
+                pending.push_back(child);
+            }
+            if (indexed) index.erase(states[id].node);
+            drop_records(id);
+            states[id].node = nullptr;
+            free_ids.push_back(id);
+        }
+        states[top].first_child = states[top].last_child = npos;
+    }
+
+    void build_index() {
+        index.clear();
+        std::vector<std::size_t> pending(1, root);
+        while (!pending.empty()) {
+            std::size_t id = pending.back();
+            pending.pop_back();
+            index[states[id].node] = id;
+            for (std::size_t child = states[id].first_child; child != npos; child = states[child].next_sibling) {
+                pending.push_back(child);
+            }
+        }
+        indexed = true;
+    }
+
+    bool refresh(const Node<T>* node, const std::vector<std::size_t>& path, std::size_t changed) {
+        // Copy-on-write may have replaced every node on the path, so follow the sibling numbers from the new root
+        for (std::size_t i = 0; i <= path.size(); ++i) {
+            std::size_t id = i < path.size() ? path[i] : changed;
+            if (states[id].node != node) {
+                index.erase(states[id].node);
+                index[node] = id;
+                states[id].node = node;
+            }
+            if (i == path.size()) break;
+            std::size_t next = i + 1 < path.size() ? path[i + 1] : changed;
+            if (states[next].number >= node->children.size()) return false;
+            node = node->children[states[next].number].get();
+        }
+        return true;
+    }
+
+    void drop_records(std::size_t id) {
+        live_records -= states[id].record_end - states[id].record_begin;
+        states[id].record_begin = states[id].record_end = 0;
+    }
+
+    void undo(std::size_t id) {
+        for (std::size_t i = states[id].record_end; i > states[id].record_begin; --i) {
+            const Record& record = log[i - 1];
+            if (record.thread) {
+                states[record.node].thread = npos;
+                states[record.node].mod = record.old_mod;
+            } else {
+                states[record.node].ancestor = record.old_ancestor;
+            }
+        }
+        drop_records(id);
+    }
+
+    void compact_log() {
+        std::vector<Record> kept;
+        kept.reserve(live_records);
+        for (auto& s : states) {
+            std::size_t begin = kept.size();
+            kept.insert(kept.end(), log.begin() + s.record_begin, log.begin() + s.record_end);
+            s.record_begin = begin;
+            s.record_end = kept.size();
+        }
+        log.swap(kept);
+    }
+
+    void first_walk(std::size_t top) { // Merges every node of the subtree, children before parents
+        std::vector<std::size_t> order(1, top);
+        for (std::size_t i = 0; i < order.size(); ++i) {
+            std::size_t id = order[i];
+            State& s = states[id];
+            s.thread = npos;
+            s.ancestor = id;
+            s.prelim = s.mod = s.shift = s.change = s.midpoint = 0;
+            drop_records(id);
+            for (std::size_t child = s.first_child; child != npos; child = states[child].next_sibling) {
+                order.push_back(child);
+            }
+        }
+        for (auto it = order.rbegin(); it != order.rend(); ++it) {
+            merge(*it);
+        }
+    }
+
+    void place(std::size_t id) { // Position relative to the left sibling, from the node's own merge
+        State& s = states[id];
+        s.shift = s.change = 0;
+        if (s.prev_sibling != npos) {
+            s.prelim = states[s.prev_sibling].prelim + DISTANCE;
+            s.mod = s.first_child != npos ? s.prelim - s.midpoint : 0;
+        } else {
+            s.prelim = s.midpoint;
+            s.mod = 0;
+        }
+    }
+
+    void merge(std::size_t id) { // Places the children of id side by side, their own subtrees are already merged
+        std::size_t begin = log.size();
+        std::size_t first = states[id].first_child;
+        if (first != npos) {
+            std::size_t default_ancestor = first;
+            for (std::size_t child = first; child != npos; child = states[child].next_sibling) {
+                place(child);
+                default_ancestor = apportion(child, default_ancestor);
+            }
+            execute_shifts(id);
+            states[id].midpoint = (states[first].prelim + states[states[id].last_child].prelim) / 2;
+        } else {
+            states[id].midpoint = 0;
+        }
+        states[id].record_begin = begin;
+        states[id].record_end = log.size();
+        live_records += log.size() - begin;
+    }
+
+    std::size_t next_left(std::size_t id) const {
+        return states[id].first_child != npos ? states[id].first_child : states[id].thread;
+    }
+
+    std::size_t next_right(std::size_t id) const {
+        return states[id].last_child != npos ? states[id].last_child : states[id].thread;
+    }
+
+    std::size_t apportion(std::size_t v, std::size_t default_ancestor) { // Pushes v clear of its left siblings
+        std::size_t left = states[v].prev_sibling;
+        if (left == npos) return default_ancestor;
+        std::size_t inner_right = v, outer_right = v, inner_left = left;
+        std::size_t outer_left = states[states[v].parent].first_child;
+        double sum_inner_right = states[inner_right].mod, sum_outer_right = states[outer_right].mod;
+        double sum_inner_left = states[inner_left].mod, sum_outer_left = states[outer_left].mod;
+        while (next_right(inner_left) != npos && next_left(inner_right) != npos) {
+            inner_left = next_right(inner_left);
+            inner_right = next_left(inner_right);
+            outer_left = next_left(outer_left);
+            outer_right = next_right(outer_right);
+            set_ancestor(outer_right, v);
+            double shift = (states[inner_left].prelim + sum_inner_left) - (states[inner_right].prelim + sum_inner_right) + DISTANCE;
+            if (shift > 0) {
+                move_subtree(ancestor(inner_left, v, default_ancestor), v, shift);
+                sum_inner_right += shift;
+                sum_outer_right += shift;
+            }
+            sum_inner_left += states[inner_left].mod;
+            sum_inner_right += states[inner_right].mod;
+            sum_outer_left += states[outer_left].mod;
+            sum_outer_right += states[outer_right].mod;
+        }
+        if (next_right(inner_left) != npos && next_right(outer_right) == npos) {
+            set_thread(outer_right, next_right(inner_left), sum_inner_left - sum_outer_right);
+        }
+        if (next_left(inner_right) != npos && next_left(outer_left) == npos) {
+            set_thread(outer_left, next_left(inner_right), sum_inner_right - sum_outer_left);
+            default_ancestor = v;
+        }
+        return default_ancestor;
+    }
+
+    void set_ancestor(std::size_t id, std::size_t value) {
+        log.push_back(Record{id, false, states[id].ancestor, 0});
+        states[id].ancestor = value;
+    }
+
+    void set_thread(std::size_t id, std::size_t target, double mod_change) {
+        log.push_back(Record{id, true, 0, states[id].mod});
+        states[id].thread = target;
+        states[id].mod += mod_change;
+    }
+
+    std::size_t ancestor(std::size_t inner_left, std::size_t v, std::size_t default_ancestor) const {
+        std::size_t candidate = states[inner_left].ancestor;
+        return states[candidate].parent == states[v].parent ? candidate : default_ancestor;
+    }
+
+    void move_subtree(std::size_t from, std::size_t to, double shift) {
+        double subtrees = double(states[to].number - states[from].number);
+        states[to].change -= shift / subtrees;
+        states[to].shift += shift;
+        states[from].change += shift / subtrees;
+        states[to].prelim += shift;
+        states[to].mod += shift;
+    }
+
+    void execute_shifts(std::size_t id) {
+        double shift = 0, change = 0;
+        for (std::size_t child = states[id].last_child; child != npos; child = states[child].prev_sibling) {
+            states[child].prelim += shift;
+            states[child].mod += shift;
+            change += states[child].change;
+            shift += states[child].shift + change;
+        }
+    }
+
+    void second_walk() { // Sums the modifiers top down into final coordinates, in BFS order
+        placed.clear();
+        spans.clear();
+        rows.clear();
+        right = 0;
+        if (root == npos) return;
+        place(root);
+        std::size_t count = states.size() - free_ids.size();
+        placed.reserve(count);
+        spans.reserve(count);
+        std::vector<std::size_t> ids;
+        std::vector<double> offsets; // Sum of the ancestors' modifiers
+        ids.reserve(count);
+        offsets.reserve(count);
+        ids.push_back(root);
+        offsets.push_back(0.0);
+        placed.push_back(Entry{states[root].node, npos, states[root].prelim, 0});
+        for (std::size_t i = 0; i < ids.size(); ++i) {
+            const State& s = states[ids[i]];
+            if (rows.size() <= s.depth) rows.push_back(i);
+            spans.push_back(Subtree{placed.size(), 0, 0, 0, s.depth, 1});
+            double below = offsets[i] + s.mod;
+            for (std::size_t child = s.first_child; child != npos; child = states[child].next_sibling) {
+                ids.push_back(child);
+                offsets.push_back(below);
+                placed.push_back(Entry{states[child].node, i, states[child].prelim + below, s.depth + 1});
+            }
+            spans[i].child_count = placed.size() - spans[i].first_child;
+        }
+        rows.push_back(placed.size());
+        double left = placed[0].x;
+        for (const auto& entry : placed) left = std::min(left, entry.x);
+        for (std::size_t i = 0; i < placed.size(); ++i) {
+            placed[i].x -= left;
+            right = std::max(right, placed[i].x);
+            spans[i].left = spans[i].right = placed[i].x;
+        }
+        for (std::size_t i = placed.size() - 1; i > 0; --i) { // Children come after their parent
+            Subtree& parent = spans[placed[i].parent];
+            parent.left = std::min(parent.left, spans[i].left);
+            parent.right = std::max(parent.right, spans[i].right);
+            parent.bottom = std::max(parent.bottom, spans[i].bottom);
+            parent.size += spans[i].size;
+        }
+    }
+};
+
+template <typename T>
+const std::size_t TreeLayout<T>::npos = std::size_t(-1);
@@ -0,0 +1,304 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "FrameStats.hpp"
+#include "Node.hpp"
+#include "Tree.hpp"
+#include "TreeDump.hpp"
+#include "TreeLayout.hpp"
+
+// Retained-mode drawing of a tree. build() computes a tidy layout once; the vertex batches (edges, collapsed subtree
+// glyphs, node circles and labels) are rebuilt only when the layout or the view changes, and hold only what the view
+// shows. Subtrees narrower than COLLAPSE_PIXELS on screen are drawn as one glyph, so the work per rebuild is bounded
+// by the screen, not by the size of the tree. Labels are written with TextFormat<T>, and the glyph quads of each
+// label are kept until the node's value may have changed, so panning and zooming never format a value again.
+template <typename T>
+class BasicTreeRenderer {
+public:
+    static constexpr float RADIUS = 15.f; // Node circle radius, the outline adds one pixel
+    static constexpr unsigned CHARACTER_SIZE = 12;
+    static constexpr float COLLAPSE_PIXELS = 12.f; // Screen width under which a subtree becomes one glyph
+    static constexpr float LABEL_PIXELS = 16.f; // Screen radius under which labels are left out
+
+    explicit BasicTreeRenderer(const sf::Font& font) // The font is loaded once by the caller and must outlive the renderer
+        : font(&font), edges(sf::Lines), summaries(sf::Triangles), circles(sf::Quads), labels(sf::Quads),
+          horizontal_spacing(0), vertical_spacing(0), laid_out_version(0), baked(false), baked_scale(0), drawn(0), collapsed(0),
+          layout_ms(0), bake_ms(0) {
+        sf::CircleShape circle(RADIUS); // Rendered once, every node is a textured quad
+        circle.setFillColor(sf::Color::White);
+        circle.setOutlineColor(sf::Color::Black);
+        circle.setOutlineThickness(1);
+        circle.setPosition(1, 1);
+        circle_texture.create(TEXTURE_SIZE, TEXTURE_SIZE);
+        circle_texture.setSmooth(true);
+        circle_texture.clear(sf::Color::Transparent);
+        circle_texture.draw(circle);
+        circle_texture.display();
+    }
+
+    BasicTreeRenderer(const BasicTreeRenderer&) = delete;
+    BasicTreeRenderer& operator=(const BasicTreeRenderer&) = delete;
+
+    // Lays the tree out. The root is drawn at origin, neighbouring nodes are at least horizontal_spacing apart and
+    // the rows vertical_spacing apart, in world coordinates.
+    template <int K>
+    void build(const Tree<T, K>& tree, sf::Vector2f origin, float horizontal_spacing, float vertical_spacing) {
+        this->origin = origin;
+        this->horizontal_spacing = horizontal_spacing;
+        this->vertical_spacing = vertical_spacing;
+        auto start = std::chrono::steady_clock::now();
+        tree_layout.layout(tree);
+        layout_ms += elapsed_ms(start);
+        label_cache.clear(); // Any value may have changed
+        laid_out_version = tree.version();
+        baked = false;
+    }
+
+    template <int K>
+    void update(const Tree<T, K>& tree, const std::shared_ptr<Node<T>>& changed) { // After a change under changed
+        auto start = std::chrono::steady_clock::now();
+        tree_layout.relayout(tree, changed);
+        layout_ms += elapsed_ms(start);
+        forget_labels(changed.get());
+        laid_out_version = tree.version();
+        baked = false;
+    }
+
+    // Lays the tree out again if it changed since the last build or update. Returns whether it did, that is whether
+    // the next frame differs from the last one.
+    template <int K>
+    bool sync(const Tree<T, K>& tree) {
+        if (tree.version() == laid_out_version) return false;
+        build(tree, origin, horizontal_spacing, vertical_spacing);
+        return true;
+    }
+
+    void draw(sf::RenderTarget& target) { // Draws through the target's current view
+        const sf::View& view = target.getView();
+        sf::FloatRect visible(view.getCenter() - view.getSize() * 0.5f, view.getSize());
+        float pixels_per_unit = target.getSize().x / view.getSize().x;
+        if (!baked || visible != baked_view || pixels_per_unit != baked_scale) {
+            auto start = std::chrono::steady_clock::now();
+            bake(visible, pixels_per_unit);
+            bake_ms += elapsed_ms(start);
+        }
+        target.draw(edges);
+        target.draw(summaries);
+        target.draw(circles, sf::RenderStates(&circle_texture.getTexture()));
+        target.draw(labels, sf::RenderStates(&font->getTexture(CHARACTER_SIZE)));
+    }
+
+    // Adds what the last draw submitted, and the layout and bake time spent since the previous collect, to sample.
+    void collect(FrameSample& sample) {
+        const sf::VertexArray* batches[] = {&edges, &summaries, &circles, &labels};
+        for (const sf::VertexArray* batch : batches) {
+            if (batch->getVertexCount() == 0) continue; // SFML skips empty arrays
+            ++sample.draw_calls;
+            sample.vertices += batch->getVertexCount();
+        }
+        sample.nodes_drawn += drawn;
+        sample.nodes_collapsed += collapsed;
+        sample.nodes_culled += tree_layout.size() - drawn - collapsed;
+        sample.layout_ms += layout_ms;
+        sample.bake_ms += bake_ms;
+        layout_ms = bake_ms = 0;
+    }
+
+    std::size_t node_count() const {
+        return tree_layout.size();
+    }
+
+    std::size_t drawn_count() const { // Nodes drawn individually by the last rebuild
+        return drawn;
+    }
+
+    std::size_t collapsed_count() const { // Nodes folded into subtree glyphs by the last rebuild
+        return collapsed;
+    }
+
+    std::size_t cached_label_count() const {
+        return label_cache.size();
+    }
+
+    const TreeLayout<T>& layout() const {
+        return tree_layout;
+    }
+
+    sf::FloatRect bounds() const { // World rectangle covering the whole tree
+        if (tree_layout.size() == 0) return sf::FloatRect(origin, sf::Vector2f(0, 0));
+        const auto& top = tree_layout.subtrees()[0];
+        sf::Vector2f low = position(top.left, 0), high = position(top.right, top.bottom);
+        return sf::FloatRect(low.x - RADIUS, low.y - RADIUS, high.x - low.x + 2 * RADIUS, high.y - low.y + 2 * RADIUS);
+    }
+
+private:
+    static constexpr unsigned TEXTURE_SIZE = 32; // Circle diameter plus the outline
+
+    const sf::Font* font;
+    sf::RenderTexture circle_texture;
+    sf::VertexArray edges; // Two vertices per edge
+    sf::VertexArray summaries; // One triangle per collapsed subtree
+    sf::VertexArray circles; // One textured quad per node
+    sf::VertexArray labels; // One quad per glyph, textured with the font page
+    TreeLayout<T> tree_layout;
+    std::unordered_map<const Node<T>*, std::vector<sf::Vertex>> label_cache; // Glyph quads relative to the node centre
+    TextBuffer label_text;
+    sf::Vector2f origin;
+    float horizontal_spacing, vertical_spacing;
+    std::size_t laid_out_version; // Tree::version() the layout was computed from
+    bool baked; // Whether the batches match the layout and baked_view
+    sf::FloatRect baked_view;
+    float baked_scale;
+    std::size_t drawn, collapsed;
+    double layout_ms, bake_ms; // Spent since the last collect()
+
+    static double elapsed_ms(std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    sf::Vector2f position(double x, std::size_t depth) const {
+        double root_x = tree_layout.entries()[0].x;
+        return sf::Vector2f(origin.x + float(x - root_x) * horizontal_spacing, origin.y + depth * vertical_spacing);
+    }
+
+    void bake(const sf::FloatRect& visible, float pixels_per_unit) { // Walks down from the root, skipping what is out of view
+        edges.clear();
+        summaries.clear();
+        circles.clear();
+        labels.clear();
+        drawn = collapsed = 0;
+        baked = true;
+        baked_view = visible;
+        baked_scale = pixels_per_unit;
+        const auto& entries = tree_layout.entries();
+        const auto& subtrees = tree_layout.subtrees();
+        if (entries.empty()) return;
+
+        float view_left = visible.left - RADIUS, view_right = visible.left + visible.width + RADIUS;
+        float view_top = visible.top - RADIUS, view_bottom = visible.top + visible.height + RADIUS;
+        bool show_labels = RADIUS * pixels_per_unit >= LABEL_PIXELS;
+        std::vector<std::size_t> pending(1, 0);
+        while (!pending.empty()) {
+            std::size_t i = pending.back();
+            pending.pop_back();
+            const auto& subtree = subtrees[i];
+            sf::Vector2f center = position(entries[i].x, entries[i].depth);
+            sf::Vector2f low = position(subtree.left, subtree.bottom);
+            sf::Vector2f high = position(subtree.right, subtree.bottom);
+            if (low.x > view_right || high.x < view_left || center.y > view_bottom || low.y < view_top) continue;
+
+            if (subtree.child_count > 0 && (high.x - low.x) * pixels_per_unit < COLLAPSE_PIXELS) {
+                add_summary(center, low, high, subtree.size, pixels_per_unit);
+                collapsed += subtree.size;
+                continue;
+            }
+            if (center.x >= view_left && center.x <= view_right && center.y >= view_top && center.y <= view_bottom) {
+                add_circle(center);
+                if (show_labels) add_label(entries[i].node, center);
+                ++drawn;
+            }
+            for (std::size_t child = subtree.first_child; child < subtree.first_child + subtree.child_count; ++child) {
+                edges.append(sf::Vertex(center, sf::Color::Red));
+                edges.append(sf::Vertex(position(entries[child].x, entries[child].depth), sf::Color::Red));
+                pending.push_back(child);
+            }
+        }
+    }
+
+    void add_summary(sf::Vector2f apex, sf::Vector2f low, sf::Vector2f high, std::size_t size, float pixels_per_unit) {
+        float half_width = 2.f / pixels_per_unit; // Keeps chains visible as thin wedges
+        if (high.x - low.x < 2 * half_width) {
+            float middle = (low.x + high.x) / 2;
+            low.x = middle - half_width;
+            high.x = middle + half_width;
+        }
+        float density = std::min(1.f, std::log2(float(size)) / 20.f); // Darker for bigger subtrees
+        sf::Color color(40, 40, 40, sf::Uint8(80 + 175 * density));
+        summaries.append(sf::Vertex(apex, color));
+        summaries.append(sf::Vertex(low, color));
+        summaries.append(sf::Vertex(high, color));
+    }
+
+    void add_circle(sf::Vector2f center) {
+        float half = TEXTURE_SIZE / 2.f;
+        float size = float(TEXTURE_SIZE);
+        circles.append(sf::Vertex(sf::Vector2f(center.x - half, center.y - half), sf::Vector2f(0, 0)));
+        circles.append(sf::Vertex(sf::Vector2f(center.x + half, center.y - half), sf::Vector2f(size, 0)));
+        circles.append(sf::Vertex(sf::Vector2f(center.x + half, center.y + half), sf::Vector2f(size, size)));
+        circles.append(sf::Vertex(sf::Vector2f(center.x - half, center.y + half), sf::Vector2f(0, size)));
+    }
+
+    void add_label(const Node<T>* node, sf::Vector2f center) {
+        auto found = label_cache.find(node);
+        if (found == label_cache.end()) {
+            found = label_cache.emplace(node, layout_label(node->data)).first;
+        }
+        for (const sf::Vertex& vertex : found->second) {
+            labels.append(sf::Vertex(vertex.position + center, vertex.color, vertex.texCoords));
+        }
+    }
+
+    std::vector<sf::Vertex> layout_label(const T& value) { // Same glyph placement as sf::Text, centred on the node
+        label_text.clear();
+        TextFormat<T>::write(label_text, value);
+        std::vector<sf::Vertex> quads;
+        quads.reserve(4 * label_text.size());
+        float x = 0;
+        float baseline = CHARACTER_SIZE / 2.f - 2; // Digits end up centred on the node
+        sf::Uint32 previous = 0;
+        for (std::size_t i = 0; i < label_text.size(); ++i) {
+            sf::Uint32 code = static_cast<unsigned char>(label_text.data()[i]);
+            x += font->getKerning(previous, code, CHARACTER_SIZE);
+            previous = code;
+            const sf::Glyph& glyph = font->getGlyph(code, CHARACTER_SIZE, false);
+            float left = x + glyph.bounds.left;
+            float top = baseline + glyph.bounds.top;
+            float right = left + glyph.bounds.width;
+            float bottom = top + glyph.bounds.height;
+            float u = float(glyph.textureRect.left), v = float(glyph.textureRect.top);
+            float u2 = u + glyph.textureRect.width, v2 = v + glyph.textureRect.height;
+            quads.push_back(sf::Vertex(sf::Vector2f(left, top), sf::Color::Black, sf::Vector2f(u, v)));
+            quads.push_back(sf::Vertex(sf::Vector2f(right, top), sf::Color::Black, sf::Vector2f(u2, v)));
+            quads.push_back(sf::Vertex(sf::Vector2f(right, bottom), sf::Color::Black, sf::Vector2f(u2, v2)));
+            quads.push_back(sf::Vertex(sf::Vector2f(left, bottom), sf::Color::Black, sf::Vector2f(u, v2)));
+            x += glyph.advance;
+        }
+        for (auto& vertex : quads) {
+            vertex.position.x -= x / 2; // Centre horizontally on the node
+        }
+        return quads;
+    }
+
+    void forget_labels(const Node<T>* changed) { // Drops the cached labels of the subtree that was laid out again
+        if (label_cache.size() > 2 * tree_layout.size() + 1024) { // Mostly nodes that left the tree
+            label_cache.clear();
+            return;
+        }
+        const auto& entries = tree_layout.entries();
+        const auto& subtrees = tree_layout.subtrees();
+        std::size_t top = 0;
+        while (top < entries.size() && entries[top].node != changed) ++top;
+        if (top == entries.size()) { // The handle was replaced by a copy, the subtree cannot be told apart
+            label_cache.clear();
+            return;
+        }
+        std::vector<std::size_t> pending(1, top);
+        while (!pending.empty()) {
+            std::size_t i = pending.back();
+            pending.pop_back();
+            label_cache.erase(entries[i].node);
+            for (std::size_t child = subtrees[i].first_child; child < subtrees[i].first_child + subtrees[i].child_count; ++child) {
+                pending.push_back(child);
+            }
+        }
+    }
+};
+
+typedef BasicTreeRenderer<double> TreeRenderer;
@@ -0,0 +1,421 @@
+#include "Node.hpp"
+#include "Tree.hpp"
+#include "Complex.hpp"
+#include "ComplexArray.hpp"
+#include "Expression.hpp"
+#include "KdTree.hpp"
+#include "ComplexQuadTree.hpp"
+#include "TreeDump.hpp"
+#include "TreeLayout.hpp"
+#include "TreeExport.hpp"
+#include "SuccinctTree.hpp"
+#include "TreeGenerator.hpp"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <unordered_set>
+#include <vector>
+
+using namespace std;
+
+volatile size_t sink; // Keeps benchmark results observable so loops are not optimised away
+
+template <typename F>
+double time_ms(F&& work) { // Runs work once and returns the elapsed time in milliseconds
+    auto start = chrono::steady_clock::now();
+    work();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+Tree<double> build_complete_tree(size_t count) { // Complete binary tree with values 0..count-1 in BFS order
+    Tree<double> tree;
+    queue<shared_ptr<Node<double>>> parents;
+    parents.push(tree.emplace_root(0.0));
+    for (size_t i = 1; i < count; ++i) {
+        auto child = tree.emplace_child(parents.front(), double(i));
+        parents.push(child);
+        if (parents.front()->children.size() == 2) parents.pop();
+    }
+    return tree;
+}
+
+shared_ptr<Node<double>> deep_copy(const shared_ptr<Node<double>>& node) { // What readers did before snapshots existed
+    auto copy = make_shared<Node<double>>(node->get_value());
+    for (const auto& child : node->children) {
+        copy->children.push_back(deep_copy(child));
+    }
+    return copy;
+}
+
+size_t distinct_nodes(const Tree<double>& first, const Tree<double>& second) { // Nodes needed to hold both versions
+    unordered_set<const Node<double>*> seen;
+    for (auto it = first.begin_bfs_scan(); it != first.end_bfs_scan(); ++it) seen.insert(*it);
+    for (auto it = second.begin_bfs_scan(); it != second.end_bfs_scan(); ++it) seen.insert(*it);
+    return seen.size();
+}
+
+void bench_snapshots() {
+    const size_t count = 1 << 20;
+    const int writes = 100;
+    auto tree = build_complete_tree(count);
+
+    shared_ptr<Node<double>> copy;
+    double deep_ms = time_ms([&] { copy = deep_copy(tree.get_root()); });
+
+    Tree<double> view;
+    double snapshot_ms = time_ms([&] { view = tree.snapshot(); });
+
+    double write_ms = time_ms([&] {
+        for (int i = 0; i < writes; ++i) {
+            auto leaf = tree.get_root();
+            for (int level = 0; !leaf->children.empty(); ++level) {
+                leaf = leaf->children[(i >> (level % 10)) & 1]; // Walk to a different leaf each time
+            }
+            tree.emplace_child(leaf, -1.0);
+        }
+    });
+
+    size_t extra = distinct_nodes(tree, view) - count - writes;
+    cout << "Snapshot of " << count << " nodes" << endl;
+    cout << "  deep copy:          " << deep_ms << " ms, " << count << " extra nodes" << endl;
+    cout << "  snapshot():         " << snapshot_ms << " ms" << endl;
+    cout << "  " << writes << " leaf inserts:   " << write_ms << " ms (handle lookup is O(n)), " << extra << " path-copied nodes" << endl;
+}
+
+struct SqrtGreater { // Comparison used by myHeap on Complex before it compared squared magnitudes
+    bool operator()(const Complex& a, const Complex& b) const { return a.magnitude() > b.magnitude(); }
+};
+
+void legacy_heap(const shared_ptr<Node<Complex>>& root) { // myHeap as it was: priority_queue of values, sqrt per compare
+    priority_queue<Complex, vector<Complex>, SqrtGreater> minHeap;
+    queue<shared_ptr<Node<Complex>>> nodeQueue;
+    nodeQueue.push(root);
+    while (!nodeQueue.empty()) {
+        auto current = nodeQueue.front();
+        nodeQueue.pop();
+        minHeap.push(current->get_value());
+        for (const auto& child : current->children) nodeQueue.push(child);
+    }
+    queue<shared_ptr<Node<Complex>>> fillQueue;
+    fillQueue.push(root);
+    while (!fillQueue.empty()) {
+        auto current = fillQueue.front();
+        fillQueue.pop();
+        current->set_value(minHeap.top());
+        minHeap.pop();
+        for (const auto& child : current->children) fillQueue.push(child);
+    }
+}
+
+Tree<Complex> build_complex_tree(size_t count, unsigned seed) { // Complete binary tree of pseudo-random values
+    Tree<Complex> tree;
+    auto next = [&seed] { seed = seed * 1103515245u + 12345u; return double(seed >> 8) / (1 << 24) * 200.0 - 100.0; };
+    queue<shared_ptr<Node<Complex>>> parents;
+    parents.push(tree.emplace_root(next(), next()));
+    for (size_t i = 1; i < count; ++i) {
+        parents.push(tree.emplace_child(parents.front(), next(), next()));
+        if (parents.front()->children.size() == 2) parents.pop();
+    }
+    return tree;
+}
+
+void print_memory(const char* label, const TreeMemory& usage) {
+    cout << "  " << label << ": " << usage.total() / 1e6 << " MB, " << usage.per_node(usage.total()) << " B/node (payload "
+         << usage.per_node(usage.payload) << ", child links " << usage.per_node(usage.child_links) << ", control "
+         << usage.per_node(usage.control) << ", allocator " << usage.per_node(usage.allocator) << ")" << endl;
+}
+
+void bench_memory() {
+    const size_t count = 1 << 20;
+    auto tree = build_complete_tree(count);
+    cout << "Memory of a complete binary tree of " << count << " doubles" << endl;
+    print_memory("linked nodes", tree.memory_usage());
+    tree.compact(Order::BFS);
+    print_memory("compacted   ", tree.memory_usage());
+    SuccinctTree<double> succinct(tree);
+    size_t succinct_bytes = succinct.structure_bytes() + succinct.value_bytes();
+    cout << "  succinct    : " << succinct_bytes / 1e6 << " MB, " << double(succinct_bytes) / count << " B/node" << endl;
+}
+
+void bench_complex_heap() {
+    const size_t count = 1 << 20;
+    auto legacy = build_complex_tree(count, 7);
+    auto current = build_complex_tree(count, 7);
+
+    double legacy_ms = time_ms([&] { legacy_heap(legacy.get_root()); });
+    double current_ms = time_ms([&] { current.myHeap(); });
+
+    bool same = true;
+    auto it = legacy.begin_bfs_scan();
+    for (auto jt = current.begin_bfs_scan(); jt != current.end_bfs_scan(); ++jt, ++it) {
+        if ((*it)->get_value() != (*jt)->get_value()) same = false;
+    }
+    cout << "myHeap on Tree<Complex> with " << count << " nodes" << endl;
+    cout << "  sqrt per comparison: " << legacy_ms << " ms" << endl;
+    cout << "  cached norm keys:    " << current_ms << " ms" << (same ? "" : " (RESULTS DIFFER)") << endl;
+}
+
+template <typename F>
+void bench_complex_array(const char* label) {
+    const size_t count = 1 << 20;
+    auto tree = build_complex_tree(count, 11);
+    BasicComplexArray<F> a, b, out;
+    for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) {
+        const Complex& value = (*it)->get_value();
+        a.push_back(BasicComplex<F>(F(value.getReal()), F(value.getImag())));
+    }
+    b = a;
+    cout << label << " over " << count << " values" << endl;
+
+    SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2};
+    const char* names[] = {"scalar", "sse2", "avx2"};
+    for (int l = 0; l < 3; ++l) {
+        if (levels[l] > BasicComplexArray<F>::supported_simd()) continue;
+        BasicComplexArray<F>::force_simd(levels[l]);
+        vector<F> magnitudes;
+        double multiply_ms = time_ms([&] { for (int r = 0; r < 10; ++r) BasicComplexArray<F>::multiply(a, b, out); }) / 10;
+        double divide_ms = time_ms([&] { for (int r = 0; r < 10; ++r) BasicComplexArray<F>::divide(a, b, out); }) / 10;
+        double magnitude_ms = time_ms([&] { for (int r = 0; r < 10; ++r) BasicComplexArray<F>::magnitude(a, magnitudes); }) / 10;
+        cout << "  " << names[l] << ": multiply " << multiply_ms << " ms, divide " << divide_ms
+             << " ms, magnitude " << magnitude_ms << " ms" << endl;
+    }
+    BasicComplexArray<F>::force_simd(BasicComplexArray<F>::supported_simd());
+}
+
+void grow_expression(Tree<ExprToken>& tree, const shared_ptr<Node<ExprToken>>& node, int depth, unsigned& seed) {
+    seed = seed * 1103515245u + 12345u;
+    if (depth == 0) { // Leaves alternate between the four variables and constants
+        node->set_value((seed >> 8) % 3 ? ExprToken::input((seed >> 12) % 4) : ExprToken::constant(Complex(1.5, -0.5)));
+        return;
+    }
+    ExprOp ops[] = {ExprOp::Add, ExprOp::Subtract, ExprOp::Multiply, ExprOp::Add};
+    node->set_value(ExprToken(ops[(seed >> 8) % 4]));
+    grow_expression(tree, tree.emplace_child(node, ExprOp::Constant), depth - 1, seed);
+    grow_expression(tree, tree.emplace_child(node, ExprOp::Constant), depth - 1, seed);
+}
+
+void bench_expression() {
+    const size_t count = 1 << 18;
+    Tree<ExprToken> tree;
+    unsigned seed = 3;
+    grow_expression(tree, tree.emplace_root(ExprOp::Add), 5, seed); // 63 nodes
+
+    vector<ComplexArray> bindings(4);
+    vector<vector<Complex>> rows(count, vector<Complex>(4));
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t v = 0; v < 4; ++v) {
+            rows[i][v] = Complex(0.001 * i + v, 1.0 - 0.002 * v);
+            bindings[v].push_back(rows[i][v]);
+        }
+    }
+
+    Complex checksum;
+    double walk_ms = time_ms([&] { for (size_t i = 0; i < count; ++i) checksum = checksum + Expression::walk(tree, rows[i]); });
+    Expression expression(tree);
+    ComplexArray results;
+    double batch_ms = time_ms([&] { expression.evaluate(bindings, results); });
+
+    cout << "Expression with 63 nodes over " << count << " bindings" << endl;
+    cout << "  tree walk:      " << count / walk_ms / 1000.0 << " M evaluations/s" << endl;
+    cout << "  compiled batch: " << count / batch_ms / 1000.0 << " M evaluations/s ("
+         << expression.instruction_count() << " instructions)" << endl;
+}
+
+void bench_kd_tree() {
+    const size_t count = 1 << 20;
+    const int queries = 1000;
+    auto tree = build_complex_tree(count, 5);
+
+    vector<Complex> points;
+    double scan_build_ms = time_ms([&] {
+        for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) points.push_back((*it)->get_value());
+    });
+    KdTree* index = nullptr;
+    double build_ms = time_ms([&] { index = new KdTree(points); });
+
+    size_t found = 0;
+    double knn_ms = time_ms([&] {
+        for (int q = 0; q < queries; ++q) found += index->nearest(points[q * 997 % count], 8).size();
+    });
+    double scan_knn_ms = time_ms([&] {
+        vector<pair<double, size_t>> distances(count);
+        for (int q = 0; q < queries / 10; ++q) {
+            Complex query = points[q * 997 % count];
+            for (size_t i = 0; i < count; ++i) distances[i] = make_pair((points[i] - query).norm(), i);
+            partial_sort(distances.begin(), distances.begin() + 8, distances.end());
+            found += distances[0].second;
+        }
+    }) * 10;
+    double box_ms = time_ms([&] {
+        for (int q = 0; q < queries; ++q) {
+            Complex center = points[q * 997 % count];
+            found += index->in_box(center - Complex(1.0, 1.0), center + Complex(1.0, 1.0)).size();
+        }
+    });
+    double scan_box_ms = time_ms([&] {
+        for (int q = 0; q < queries / 10; ++q) {
+            Complex center = points[q * 997 % count];
+            for (const auto& point : points) {
+                found += point.getReal() >= center.getReal() - 1.0 && point.getReal() <= center.getReal() + 1.0 &&
+                         point.getImag() >= center.getImag() - 1.0 && point.getImag() <= center.getImag() + 1.0;
+            }
+        }
+    }) * 10;
+    delete index;
+
+    cout << "K-d tree over " << count << " points (gather " << scan_build_ms << " ms, build " << build_ms << " ms)" << endl;
+    cout << "  " << queries << " 8-NN queries:  " << knn_ms << " ms, linear scan " << scan_knn_ms << " ms" << endl;
+    cout << "  " << queries << " box queries:   " << box_ms << " ms, linear scan " << scan_box_ms << " ms"
+         << endl;
+    sink = found;
+}
+
+void bench_quadtree() {
+    const size_t count = 1 << 20;
+    const int queries = 1000;
+    auto tree = build_complex_tree(count, 9);
+    vector<Complex> points;
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) points.push_back((*it)->get_value());
+
+    ComplexQuadTree quadtree(Complex(0.0, 0.0), 1.0);
+    double insert_ms = time_ms([&] {
+        for (const auto& point : points) quadtree.insert(point);
+    });
+    size_t found = 0;
+    double query_ms = time_ms([&] {
+        for (int q = 0; q < queries; ++q) {
+            Complex center = points[q * 997 % count];
+            found += quadtree.query(center - Complex(1.0, 1.0), center + Complex(1.0, 1.0)).size();
+        }
+    });
+    double count_ms = time_ms([&] {
+        for (int q = 0; q < queries; ++q) {
+            Complex center = points[q * 997 % count];
+            found += quadtree.count(center - Complex(20.0, 20.0), center + Complex(20.0, 20.0));
+        }
+    });
+    double lod_ms = time_ms([&] { found += quadtree.level_of_detail(6).size(); });
+
+    cout << "Quadtree over " << count << " points" << endl;
+    cout << "  inserts:            " << insert_ms << " ms (" << count / insert_ms / 1000.0 << " M/s)" << endl;
+    cout << "  " << queries << " box queries:   " << query_ms << " ms" << endl;
+    cout << "  " << queries << " wide counts:   " << count_ms << " ms (aggregates)" << endl;
+    cout << "  level 6 summaries:  " << lod_ms << " ms" << endl;
+    sink = found;
+}
+
+void bench_text_dump() {
+    const size_t count = 1 << 20;
+    auto tree = build_complex_tree(count, 13);
+    ofstream out("/dev/null");
+
+    double stream_ms = time_ms([&] {
+        for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) out << (*it)->get_value() << endl;
+    });
+    TextBuffer buffer;
+    double dump_ms = time_ms([&] {
+        dump(tree, Traversal::BFS, buffer);
+        buffer.write_to(out);
+    });
+    dump(tree, Traversal::BFS, buffer);
+    double megabytes = buffer.size() / 1e6;
+    buffer.clear();
+    TextBuffer short_buffer(6);
+    double rounded_ms = time_ms([&] {
+        dump(tree, Traversal::BFS, short_buffer);
+        short_buffer.write_to(out);
+    });
+
+    cout << "Text dump of " << count << " Complex values (" << megabytes << " MB shortest form)" << endl;
+    cout << "  operator<< and endl: " << stream_ms << " ms" << endl;
+    cout << "  dump, shortest form: " << dump_ms << " ms (" << megabytes / dump_ms * 1000.0 << " MB/s)" << endl;
+    cout << "  dump, 6 digits:      " << rounded_ms << " ms" << endl;
+}
+
+void bench_layout() {
+    const size_t count = 1 << 20;
+    auto tree = build_complex_tree(count, 17);
+    TreeLayout<Complex> layout;
+    double full_ms = time_ms([&] { layout.layout(tree); });
+
+    const int edits = 100;
+    double relayout_ms = time_ms([&] {
+        for (int i = 0; i < edits; ++i) {
+            auto target = tree.get_root();
+            for (int depth = 0; !target->children.empty(); ++depth) {
+                target = target->children[((i >> (depth % 7)) & 1) % target->children.size()];
+            }
+            tree.emplace_child(target, double(i), 0.0);
+            layout.relayout(tree, target);
+        }
+    });
+    double rebuild_ms = time_ms([&] { layout.layout(tree); }) * edits;
+    sink = layout.size();
+
+    cout << "Tidy layout of " << count << " nodes: " << full_ms << " ms" << endl;
+    cout << "  " << edits << " leaf inserts with relayout: " << relayout_ms << " ms, full layout each time " << rebuild_ms << " ms"
+         << endl;
+}
+
+void bench_export() {
+    const size_t count = 1 << 20;
+    auto tree = build_complex_tree(count, 19);
+    TreeLayout<Complex> layout(tree);
+    ofstream out("/dev/null");
+
+    double svg_ms = time_ms([&] { write_svg(out, layout); });
+    ExportStyle fitted;
+    fitted.max_width = 4096;
+    fitted.max_height = 4096;
+    ExportFrame frame(layout, fitted);
+    double ppm_ms = time_ms([&] { write_ppm(out, layout, fitted); });
+
+    cout << "Headless export of " << count << " Complex nodes" << endl;
+    cout << "  SVG: " << svg_ms << " ms" << endl;
+    cout << "  PPM " << frame.width << "x" << frame.height << ": " << ppm_ms << " ms" << endl;
+}
+
+void bench_generator() { // Construction only, the trees are freed outside the timed part
+    const size_t count = 10000000;
+    cout << "Generating trees of " << count << " nodes" << endl;
+    {
+        Tree<double> tree;
+        double ms = time_ms([&] { tree = build_complete_tree(count); });
+        cout << "  complete, emplace_child: " << ms << " ms (" << ms * 1e6 / count << " ns/node)" << endl;
+    }
+    const pair<Shape, const char*> shapes[] = {
+        {Shape::Complete, "complete"}, {Shape::RandomRecursive, "random recursive"},
+        {Shape::PreferentialAttachment, "preferential attachment"}, {Shape::Caterpillar, "caterpillar"},
+        {Shape::DeepChain, "deep chain"}};
+    WorkloadSpec spec;
+    spec.nodes = count;
+    for (const auto& shape : shapes) {
+        spec.shape = shape.first;
+        Tree<double> tree;
+        double ms = time_ms([&] { tree = generate_tree<double>(spec); });
+        cout << "  " << shape.second << ", generate_tree<double>: " << ms << " ms (" << ms * 1e6 / count << " ns/node)" << endl;
+    }
+    spec.shape = Shape::RandomRecursive;
+    spec.values = Values::Normal;
+    Tree<Complex> tree;
+    double ms = time_ms([&] { tree = generate_tree<Complex>(spec); });
+    cout << "  random recursive, normal generate_tree<Complex>: " << ms << " ms (" << ms * 1e6 / count << " ns/node)" << endl;
+}
+
+int main() {
+    bench_snapshots();
+    bench_memory();
+    bench_complex_heap();
+    bench_complex_array<double>("ComplexArray");
+    bench_complex_array<float>("ComplexArrayF");
+    bench_expression();
+    bench_kd_tree();
+    bench_quadtree();
+    bench_text_dump();
+    bench_layout();
+    bench_export();
+    bench_generator();
+    return 0;
+}
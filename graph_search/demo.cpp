@@ -1,14 +1,19 @@
 #include <SFML/Graphics.hpp>
 #include "Node.hpp"
 #include "Tree.hpp"
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
+#include <random>
+#include <vector>
 #include "Complex.hpp"
+#include "TreeDump.hpp"
+#include "TreeRenderer.hpp"
 
 using namespace std;
 
-void drawNode(sf::RenderWindow& window, std::shared_ptr<Node<double>> node, float x, float y, float horizontalSpacing, float verticalSpacing);
-
-int main() {
+int main(int argc, char* argv[]) {
     // Create the first tree (binary tree)
     Node<double> root_node1 = Node<double>(1.1);
     Tree<double> tree1;
@@ -75,78 +80,50 @@ int main() {
 
 
     // Print traversals for the binary tree
-    cout << "Binary Tree Pre-Order:" << endl;
-    for (auto it = tree1.begin_pre_order(); it != tree1.end_pre_order(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree Pre-Order:" << '\n';
+    dump(cout, tree1, Traversal::PreOrder);
 
-    cout << "Binary Tree Post-Order:" << endl;
-    for (auto it = tree1.begin_post_order(); it != tree1.end_post_order(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree Post-Order:" << '\n';
+    dump(cout, tree1, Traversal::PostOrder);
 
-    cout << "Binary Tree In-Order:" << endl;
-    for (auto it = tree1.begin_in_order(); it != tree1.end_in_order(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree In-Order:" << '\n';
+    dump(cout, tree1, Traversal::InOrder);
 
-    cout << "Binary Tree BFS:" << endl;
-    for (auto it = tree1.begin_bfs_scan(); it != tree1.end_bfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree BFS:" << '\n';
+    dump(cout, tree1, Traversal::BFS);
 
-    cout << "Binary Tree DFS:" << endl;
-    for (auto it = tree1.begin_dfs_scan(); it != tree1.end_dfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree DFS:" << '\n';
+    dump(cout, tree1, Traversal::DFS);
 
     // Print traversals for the 3-ary tree
-    cout << "3-Ary Tree Pre-Order (DFS):" << endl;
-    for (auto it = tree2.begin_dfs_scan(); it != tree2.end_dfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "3-Ary Tree Pre-Order (DFS):" << '\n';
+    dump(cout, tree2, Traversal::DFS);
 
-    cout << "3-Ary Tree Post-Order (DFS):" << endl;
-    for (auto it = tree2.begin_dfs_scan(); it != tree2.end_dfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "3-Ary Tree Post-Order (DFS):" << '\n';
+    dump(cout, tree2, Traversal::DFS);
 
-    cout << "3-Ary Tree In-Order (DFS):" << endl;
-    for (auto it = tree2.begin_dfs_scan(); it != tree2.end_dfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "3-Ary Tree In-Order (DFS):" << '\n';
+    dump(cout, tree2, Traversal::DFS);
 
-    cout << "3-Ary Tree BFS:" << endl;
-    for (auto it = tree2.begin_bfs_scan(); it != tree2.end_bfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "3-Ary Tree BFS:" << '\n';
+    dump(cout, tree2, Traversal::BFS);
 
-    cout << "3-Ary Tree DFS:" << endl;
-    for (auto it = tree2.begin_dfs_scan(); it != tree2.end_dfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "3-Ary Tree DFS:" << '\n';
+    dump(cout, tree2, Traversal::DFS);
 
     // Convert binary tree to Min-Heap and print values
-    cout << "Binary Tree Heap:" << endl;
+    cout << "Binary Tree Heap:" << '\n';
     tree3.myHeap();
-    for (auto it = tree3.begin_bfs_scan(); it != tree3.end_bfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    dump(cout, tree3, Traversal::BFS);
   //  cout<<endl;
-    cout << "Binary Tree In-Order (Complex):" << endl;
-    for (auto it = tree4.begin_in_order(); it != tree4.end_in_order(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree In-Order (Complex):" << '\n';
+    dump(cout, tree4, Traversal::InOrder);
 
-    cout << "Binary Tree BFS (Complex):" << endl;
-    for (auto it = tree4.begin_bfs_scan(); it != tree4.end_bfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree BFS (Complex):" << '\n';
+    dump(cout, tree4, Traversal::BFS);
 
-    cout << "Binary Tree DFS (Complex):" << endl;
-    for (auto it = tree4.begin_dfs_scan(); it != tree4.end_dfs_scan(); ++it) {
-        cout << (*it)->get_value() << endl;
-    }
+    cout << "Binary Tree DFS (Complex):" << '\n';
+    dump(cout, tree4, Traversal::DFS);
 
     // Create window with video mode and title
     sf::RenderWindow window(sf::VideoMode(1200, 600), "Forest visualization");
@@ -160,75 +137,185 @@ int main() {
         std::cerr << "Setting vertical sync not supported: " << e.what() << std::endl;
     }
 
-    while (window.isOpen()) {
-        sf::Event event;
-        while (window.pollEvent(event)) {
-            if (event.type == sf::Event::Closed)
-                window.close();
-        }
-
-        window.clear(sf::Color::White);
+    // Load the font once for all the renderers
+    sf::Font font;
+    if (!font.loadFromFile("arial.ttf")) {
+        std::cerr << "Failed to load font!" << std::endl;
+        return 1;
+    }
 
-        // Display the binary tree
-        if (tree1.get_root()) {
-            drawNode(window, tree1.get_root(), window.getSize().x / 6, 50, 100, 50);
+    // Lay out and build the geometry of each tree once, the frames only submit it
+    TreeRenderer renderer1(font), renderer2(font), renderer3(font), renderer5(font);
+    BasicTreeRenderer<Complex> renderer4(font);
+    renderer1.build(tree1, sf::Vector2f(window.getSize().x / 8, 50), 50, 50); // The binary tree
+    renderer2.build(tree2, sf::Vector2f(3 * window.getSize().x / 8, 50), 50, 50); // The 3-ary tree
+    renderer3.build(tree3, sf::Vector2f(5 * window.getSize().x / 8, 50), 50, 50); // The binary heap tree
+    renderer4.build(tree4, sf::Vector2f(7 * window.getSize().x / 8, 50), 70, 50); // The Complex tree, wider labels
+
+    // An optional large random binary tree, e.g. ./tree 100000, drawn below the others to try the culling and zoom.
+    // Space adds another random node to it.
+    Tree<double> tree5;
+    std::size_t extra = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 0;
+    std::mt19937 random(5);
+    std::vector<std::shared_ptr<Node<double>>> open; // Nodes with room for another child
+    auto grow = [&]() {
+        std::size_t pick = random() % open.size();
+        auto child = tree5.emplace_child(open[pick], double(tree5.version()));
+        if (open[pick]->children.size() == 2) {
+            open[pick] = open.back(); // Full parents leave the candidates
+            open.pop_back();
         }
+        open.push_back(child);
+    };
+    if (extra > 0) {
+        open.push_back(tree5.emplace_root(0.0));
+        for (std::size_t i = 1; i < extra; ++i) grow();
+        renderer5.build(tree5, sf::Vector2f(window.getSize().x / 2, 300), 50, 50);
+    }
 
-        // Display the 3-ary tree
-        if (tree2.get_root()) {
-            drawNode(window, tree2.get_root(), window.getSize().x / 2, 50, 100, 50);
+    // Mouse wheel zooms around the cursor, dragging or the arrow keys pan, +/- zoom, Home resets
+    sf::View home = window.getDefaultView();
+    sf::View view = home;
+    bool dragging = false;
+    sf::Vector2i drag_from;
+
+    // F1 shows frame statistics, F2 starts and stops a per-frame log that is saved to frame_stats.csv
+    FrameStats frame_stats;
+    bool overlay = false;
+    auto save_log = [&]() {
+        std::ofstream csv("frame_stats.csv");
+        frame_stats.write_csv(csv);
+        std::cout << "Wrote " << frame_stats.log_size() << " frames to frame_stats.csv" << std::endl;
+    };
+
+    auto handle = [&](const sf::Event& event) { // Returns whether the event changes what is on screen
+        if (event.type == sf::Event::Closed) {
+            window.close();
+        } else if (event.type == sf::Event::Resized) { // Keep the scale, show more or less of the world
+            float scale = view.getSize().x / home.getSize().x;
+            view.setSize(event.size.width * scale, event.size.height * scale);
+            home.setSize(float(event.size.width), float(event.size.height));
+        } else if (event.type == sf::Event::GainedFocus) {
+            // Redraw in case the window contents were lost while hidden
+        } else if (event.type == sf::Event::MouseWheelScrolled) {
+            sf::Vector2i pixel(event.mouseWheelScroll.x, event.mouseWheelScroll.y);
+            sf::Vector2f before = window.mapPixelToCoords(pixel, view);
+            view.zoom(event.mouseWheelScroll.delta > 0 ? 0.8f : 1.25f);
+            sf::Vector2f after = window.mapPixelToCoords(pixel, view);
+            view.move(before - after); // The point under the cursor stays put
+        } else if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+            dragging = true;
+            drag_from = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
+            return false;
+        } else if (event.type == sf::Event::MouseButtonReleased && event.mouseButton.button == sf::Mouse::Left) {
+            dragging = false;
+            return false;
+        } else if (event.type == sf::Event::MouseMoved && dragging) {
+            sf::Vector2i to(event.mouseMove.x, event.mouseMove.y);
+            view.move(window.mapPixelToCoords(drag_from, view) - window.mapPixelToCoords(to, view));
+            drag_from = to;
+        } else if (event.type == sf::Event::KeyPressed) {
+            float step = view.getSize().x / 10;
+            switch (event.key.code) {
+                case sf::Keyboard::Left: view.move(-step, 0); break;
+                case sf::Keyboard::Right: view.move(step, 0); break;
+                case sf::Keyboard::Up: view.move(0, -step); break;
+                case sf::Keyboard::Down: view.move(0, step); break;
+                case sf::Keyboard::Add: case sf::Keyboard::Equal: view.zoom(0.8f); break;
+                case sf::Keyboard::Subtract: case sf::Keyboard::Hyphen: view.zoom(1.25f); break;
+                case sf::Keyboard::Home: view = home; break;
+                case sf::Keyboard::Space: if (extra > 0) grow(); break; // Picked up through tree5.version()
+                case sf::Keyboard::F1: overlay = !overlay; break;
+                case sf::Keyboard::F2:
+                    if (frame_stats.logging_enabled()) {
+                        frame_stats.stop_log();
+                        save_log();
+                    } else {
+                        frame_stats.start_log();
+                    }
+                    break;
+                default: return false;
+            }
+        } else {
+            return false;
         }
+        return true;
+    };
 
-        // Display the binary heap tree
-        if (tree3.get_root()) {
-            drawNode(window, tree3.get_root(), 5 * window.getSize().x / 6, 50, 100, 50);
+    // Frames are drawn only when an event or a change to one of the trees asks for it, the loop sleeps otherwise
+    bool dirty = true; // Nothing has been drawn yet
+    while (window.isOpen()) {
+        sf::Event event;
+        if (!dirty && window.waitEvent(event)) {
+            dirty = handle(event);
+        }
+        while (window.pollEvent(event)) {
+            if (handle(event)) dirty = true;
+        }
+        if (renderer1.sync(tree1)) dirty = true;
+        if (renderer2.sync(tree2)) dirty = true;
+        if (renderer3.sync(tree3)) dirty = true;
+        if (renderer4.sync(tree4)) dirty = true;
+        if (extra > 0 && renderer5.sync(tree5)) dirty = true;
+        if (!dirty || !window.isOpen()) continue;
+
+        auto frame_start = std::chrono::steady_clock::now();
+        window.clear(sf::Color::White);
+        window.setView(view);
+        renderer1.draw(window);
+        renderer2.draw(window);
+        renderer3.draw(window);
+        renderer4.draw(window);
+        if (extra > 0) renderer5.draw(window);
+
+        FrameSample sample; // The overlay itself is not counted
+        renderer1.collect(sample);
+        renderer2.collect(sample);
+        renderer3.collect(sample);
+        renderer4.collect(sample);
+        if (extra > 0) renderer5.collect(sample);
+        if (overlay) {
+            TextBuffer text(3);
+            text.append("frame ms  p50 ");
+            text.append(frame_stats.percentile(50));
+            text.append("  p95 ");
+            text.append(frame_stats.percentile(95));
+            text.append("  p99 ");
+            text.append(frame_stats.percentile(99));
+            text.append("  max ");
+            text.append(frame_stats.percentile(100));
+            text.append("\ndraw calls ");
+            text.append(sample.draw_calls);
+            text.append("  vertices ");
+            text.append(sample.vertices);
+            text.append("\nnodes drawn ");
+            text.append(sample.nodes_drawn);
+            text.append("  collapsed ");
+            text.append(sample.nodes_collapsed);
+            text.append("  culled ");
+            text.append(sample.nodes_culled);
+            text.append("\nlayout ms ");
+            text.append(sample.layout_ms);
+            text.append("  bake ms ");
+            text.append(sample.bake_ms);
+            text.append(frame_stats.logging_enabled() ? "\nlogging (F2 to save)" : "\nF2 to log frames");
+            sf::Text label(std::string(text.data(), text.size()), font, 14);
+            label.setFillColor(sf::Color::Black);
+            label.setPosition(10, 10);
+            sf::FloatRect box = label.getGlobalBounds();
+            sf::RectangleShape background(sf::Vector2f(box.width + 20, box.height + 20));
+            background.setPosition(box.left - 10, box.top - 10);
+            background.setFillColor(sf::Color(255, 255, 255, 200));
+            window.setView(sf::View(sf::FloatRect(0, 0, float(window.getSize().x), float(window.getSize().y))));
+            window.draw(background);
+            window.draw(label);
         }
-
         window.display();
+        sample.frame_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame_start).count();
+        frame_stats.record(sample);
+        dirty = false;
     }
 
+    if (frame_stats.logging_enabled()) save_log();
     return 0;
 }
-
-void drawNode(sf::RenderWindow& window, std::shared_ptr<Node<double>> node, float x, float y, float horizontalSpacing, float verticalSpacing) {
-    // Calculate the position for children nodes
-    float childX = x - (node->children.size() - 1) * horizontalSpacing / 2;
-    for (auto& child : node->children) {
-        // Draw a red line from the current node to the child node
-        sf::Vertex line[] = {
-                sf::Vertex(sf::Vector2f(x, y), sf::Color::Red),
-                sf::Vertex(sf::Vector2f(childX, y + verticalSpacing), sf::Color::Red)
-        };
-        window.draw(line, 2, sf::Lines);
-
-        // Recursively draw the child node
-        drawNode(window, child, childX, y + verticalSpacing, horizontalSpacing / 2, verticalSpacing);
-        childX += horizontalSpacing; // Update position for the next child
-    }
-
-    // Draw the node circle
-    sf::CircleShape circle(15); // Circle with radius 15
-    circle.setFillColor(sf::Color::White); // White fill color
-    circle.setOutlineColor(sf::Color::Black); // Black outline color
-    circle.setOutlineThickness(1); // Outline thickness
-    circle.setPosition(x - 15, y - 15); // Position circle centered on (x, y)
-
-    // Load font for the node value
-    sf::Font font;
-    if (!font.loadFromFile("arial.ttf")) {
-        std::cerr << "Failed to load font!" << std::endl;
-        return;
-    }
-
-    // Draw the node value text
-    sf::Text text;
-    text.setFont(font); // Set font
-    text.setString(std::to_string(node->get_value())); // Set text to node value
-    text.setCharacterSize(12); // Character size
-    text.setFillColor(sf::Color::Black); // Text color
-    text.setPosition(x - 10, y - 10); // Position text centered on (x, y)
-
-    // Draw the circle and text
-    window.draw(circle);
-    window.draw(text);
-}
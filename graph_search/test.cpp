@@ -1,9 +1,24 @@
-#define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
+#define TREE_STATS // The cases in this file run with the operation counters compiled in, TestDefaultBuild.cpp without
 #include "doctest.h"
+#include "AllocationCounter.hpp"
 #include "Node.hpp"
 #include "Tree.hpp"
 #include "Complex.hpp"
+#include "SuccinctTree.hpp"
+#include "ComplexArray.hpp"
+#include "Expression.hpp"
+#include "KdTree.hpp"
+#include "ComplexQuadTree.hpp"
+#include "TreeDump.hpp"
+#include "TreeLayout.hpp"
+#include "TreeExport.hpp"
+#include "FrameStats.hpp"
+#include "TreeGenerator.hpp"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <sstream>
+#include <string>
 
 using namespace std;
 
@@ -99,6 +114,26 @@ TEST_CASE("Binary Tree Traversals") {
     }
 }
 
+TEST_CASE("Binary Pre-Order Visits Each Node Once") {
+    Tree<double> tree;
+    auto root = tree.emplace_root(1.0);
+    auto left = tree.emplace_child(root, 2.0);
+    tree.emplace_child(root, 3.0);
+    tree.emplace_child(left, 4.0);
+
+    vector<double> visited;
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) {
+        visited.push_back((*it)->get_value());
+    }
+    CHECK(visited == vector<double>{1.0, 2.0, 4.0, 3.0});
+
+    Tree<double> single;
+    single.emplace_root(7.0);
+    size_t count = 0;
+    for (auto it = single.begin_pre_order(); it != single.end_pre_order(); ++it) ++count;
+    CHECK(count == 1);
+}
+
 TEST_CASE("3-Ary Tree Traversals") {
     Node<double> root_node(1.0);
     Tree<double, 3> tree;
@@ -269,3 +304,1640 @@ TEST_CASE("Binary Tree with Complex Numbers") {
 
 }
 
+
+TEST_CASE("Tree Compaction") {
+    Node<double> root_node(1.0);
+    Tree<double> tree;
+    tree.add_root(root_node);
+    Node<double> n1(2.0);
+    Node<double> n2(3.0);
+    Node<double> n3(4.0);
+    Node<double> n4(5.0);
+    Node<double> n5(6.0);
+
+    tree.add_sub_node(root_node, n1);
+    tree.add_sub_node(root_node, n2);
+    tree.add_sub_node(n1, n3);
+    tree.add_sub_node(n1, n4);
+    tree.add_sub_node(n2, n5);
+
+    SUBCASE("DFS Order") {
+        CHECK(tree.compact(Order::DFS) > 0);
+        vector<double> expected = {1.0, 2.0, 4.0, 5.0, 3.0, 6.0};
+        Node<double>* previous = nullptr;
+        auto it = tree.begin_dfs_scan();
+        for (double val : expected) {
+            CHECK((*it)->get_value() == val);
+            if (previous) CHECK(*it == previous + 1); // Sequential in memory
+            previous = *it;
+            ++it;
+        }
+    }
+
+    SUBCASE("BFS Order") {
+        CHECK(tree.compact(Order::BFS) > 0);
+        vector<double> expected = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+        Node<double>* previous = nullptr;
+        auto it = tree.begin_bfs_scan();
+        for (double val : expected) {
+            CHECK((*it)->get_value() == val);
+            if (previous) CHECK(*it == previous + 1);
+            previous = *it;
+            ++it;
+        }
+    }
+
+    SUBCASE("Adding after compaction") {
+        tree.compact();
+        Node<double> n6(7.0);
+        tree.add_sub_node(n2, n6);
+        vector<double> expected = {1.0, 2.0, 4.0, 5.0, 3.0, 6.0, 7.0};
+        auto it = tree.begin_pre_order();
+        for (double val : expected) {
+            CHECK((*it)->get_value() == val);
+            ++it;
+        }
+        CHECK(tree.compact() > 0); // The new node moves into the arena
+    }
+}
+
+TEST_CASE("Compacted Tree Lifetime") {
+    auto build = [](Tree<double>& tree) { // 1 with children 2 and 3, 2 with children 4 and 5, 3 with child 6
+        auto root = tree.emplace_root(1.0);
+        auto left = tree.emplace_child(root, 2.0);
+        auto right = tree.emplace_child(root, 3.0);
+        tree.emplace_child(left, 4.0);
+        tree.emplace_child(left, 5.0);
+        tree.emplace_child(right, 6.0);
+        tree.compact();
+    };
+
+    SUBCASE("Handles outlive the tree") {
+        AllocationScope scope;
+        shared_ptr<Node<double>> root, child;
+        {
+            Tree<double> tree;
+            build(tree);
+            root = tree.get_root();
+            child = tree.get_root()->children[0];
+        }
+        CHECK(root->children.size() == 2); // The root handle keeps the tree whole
+        CHECK(child->get_value() == 2.0);
+        root.reset();
+        CHECK(child->get_value() == 2.0); // Child links of a compacted tree only keep their node
+        child.reset();
+        CHECK(scope.live() == 0);
+    }
+
+    SUBCASE("Detached subtrees stay whole") {
+        AllocationScope scope;
+        shared_ptr<Node<double>> subtree;
+        {
+            Tree<double> tree;
+            build(tree);
+            subtree = tree.detach(tree.get_root()->children[0]);
+        }
+        REQUIRE(subtree->children.size() == 2);
+        CHECK(subtree->children[1]->get_value() == 5.0);
+        subtree.reset();
+        CHECK(scope.live() == 0);
+    }
+
+    SUBCASE("Reattached under a linked node") {
+        AllocationScope scope;
+        {
+            Tree<double> tree;
+            build(tree);
+            auto linked = tree.emplace_child(tree.get_root()->children[1], 7.0);
+            auto subtree = tree.detach(tree.get_root()->children[0]);
+            CHECK(tree.reattach(linked, subtree));
+        }
+        CHECK(scope.live() == 0);
+    }
+
+    SUBCASE("Removed nodes are reused") {
+        AllocationScope scope;
+        {
+            Tree<double> tree;
+            build(tree);
+            auto view = tree.snapshot();
+            CHECK(tree.remove_subtree(tree.get_root()->children[1]));
+            CHECK(tree.free_node_count() == 0); // The snapshot still shows them
+        }
+        {
+            Tree<double> tree;
+            build(tree);
+            CHECK(tree.remove_subtree(tree.get_root()->children[0]));
+            CHECK(tree.free_node_count() == 3);
+            auto added = tree.emplace_child(tree.get_root()->children[0], 8.0);
+            CHECK(tree.free_node_count() == 2);
+            CHECK(tree.stats().reuses == 1);
+            CHECK(added->get_value() == 8.0);
+        }
+        CHECK(scope.live() == 0);
+    }
+}
+
+struct CopyCounter { // Payload that records how often it was copied
+    static int copies;
+    int id;
+    std::string text;
+
+    CopyCounter(int id, const std::string& text) : id(id), text(text) {}
+    CopyCounter(const CopyCounter& other) : id(other.id), text(other.text) { ++copies; }
+    CopyCounter(CopyCounter&& other) : id(other.id), text(std::move(other.text)) {}
+    CopyCounter& operator=(const CopyCounter& other) { id = other.id; text = other.text; ++copies; return *this; }
+    CopyCounter& operator=(CopyCounter&& other) { id = other.id; text = std::move(other.text); return *this; }
+    bool operator==(const CopyCounter& other) const { return id == other.id; }
+};
+int CopyCounter::copies = 0;
+
+TEST_CASE("Move and Emplace Insertion") {
+    CopyCounter::copies = 0;
+    Tree<CopyCounter> tree;
+
+    SUBCASE("Emplace") {
+        auto root = tree.emplace_root(1, "root");
+        auto left = tree.emplace_child(root, 2, "left");
+        tree.emplace_child(root, 3, "right");
+        CHECK(tree.emplace_child(root, 4, "extra") == nullptr); // Binary tree is full
+        tree.emplace_child(left, 5, "leaf");
+        CHECK(root->children.size() == 2);
+        CHECK(tree.get_root()->get_value().text == "root");
+        CHECK(left->children[0]->get_value().text == "leaf");
+        CHECK_THROWS(tree.emplace_child(nullptr, 6, "orphan"));
+        CHECK(CopyCounter::copies == 0);
+    }
+
+    SUBCASE("Move") {
+        tree.add_root(Node<CopyCounter>(CopyCounter(1, "root")));
+        tree.add_sub_node(Node<CopyCounter>(CopyCounter(1, "")), Node<CopyCounter>(CopyCounter(2, "child")));
+        const CopyCounter& value = tree.get_root()->children[0]->get_value();
+        CHECK(value.text == "child");
+        CHECK(CopyCounter::copies == 0);
+    }
+
+    SUBCASE("Copy") {
+        Node<CopyCounter> root_node(CopyCounter(1, "root"));
+        tree.add_root(root_node);
+        CHECK(CopyCounter::copies == 1);
+    }
+}
+
+TEST_CASE("Subtree Removal and Node Recycling") {
+    Tree<double> tree;
+    auto root = tree.emplace_root(1.0);
+    auto left = tree.emplace_child(root, 2.0);
+    auto right = tree.emplace_child(root, 3.0);
+    tree.emplace_child(left, 4.0);
+    tree.emplace_child(left, 5.0);
+    tree.emplace_child(right, 6.0);
+
+    SUBCASE("Remove subtree") {
+        vector<Node<double>*> removed = {left.get(), left->children[0].get(), left->children[1].get()};
+        left.reset(); // Only the tree references the subtree now
+        CHECK(tree.remove_subtree(tree.find_node(root, Node<double>(2.0))));
+        CHECK(tree.free_node_count() == 3);
+        CHECK(root->children.size() == 1);
+
+        auto reused = tree.emplace_child(root, 7.0);
+        CHECK(tree.free_node_count() == 2);
+        CHECK(reused->children.empty());
+        CHECK(std::find(removed.begin(), removed.end(), reused.get()) != removed.end()); // No new allocation
+
+        vector<double> expected = {1.0, 3.0, 6.0, 7.0};
+        auto it = tree.begin_dfs_scan();
+        for (double val : expected) {
+            CHECK((*it)->get_value() == val);
+            ++it;
+        }
+
+        tree.release_free_nodes();
+        CHECK(tree.free_node_count() == 0);
+    }
+
+    SUBCASE("Externally held nodes are not recycled") {
+        CHECK(tree.remove_subtree(left));
+        CHECK(tree.free_node_count() == 0);
+        CHECK(left->children.size() == 2); // The caller's subtree is untouched
+    }
+
+    SUBCASE("Remove missing node") {
+        auto stranger = std::make_shared<Node<double>>(9.0);
+        CHECK_FALSE(tree.remove_subtree(stranger));
+    }
+
+    SUBCASE("Detach and reattach") {
+        auto subtree = tree.detach(left);
+        CHECK(subtree == left);
+        CHECK(root->children.size() == 1);
+        CHECK_FALSE(tree.reattach(right, nullptr));
+        CHECK(tree.reattach(right, subtree));
+        vector<double> expected = {1.0, 3.0, 6.0, 2.0, 4.0, 5.0};
+        auto it = tree.begin_dfs_scan();
+        for (double val : expected) {
+            CHECK((*it)->get_value() == val);
+            ++it;
+        }
+        CHECK_FALSE(tree.reattach(right, std::make_shared<Node<double>>(8.0))); // Binary tree is full
+    }
+
+    SUBCASE("Copies do not share the free list") {
+        left.reset();
+        CHECK(tree.remove_subtree(tree.find_node(root, Node<double>(2.0))));
+        CHECK(tree.free_node_count() == 3);
+
+        Tree<double> copy(tree);
+        CHECK(copy.free_node_count() == 0);
+        CHECK(copy.get_root() != tree.get_root());
+        auto from_tree = tree.emplace_child(tree.get_root(), 7.0);
+        auto from_copy = copy.emplace_child(copy.get_root(), 8.0);
+        CHECK(from_tree != from_copy);
+        CHECK(tree.free_node_count() == 2);
+        CHECK(tree.get_root()->children.size() == 2);
+        CHECK(copy.get_root()->children.size() == 2);
+        CHECK(copy.get_root()->children[0]->children[0]->get_value() == 6.0);
+
+        auto view = copy.snapshot();
+        copy = tree; // Assignment copies too, and leaves the snapshot of the old copy alone
+        CHECK(copy.free_node_count() == 0);
+        CHECK(copy.get_root()->children[1]->get_value() == 7.0);
+        CHECK(view.get_root()->children[1]->get_value() == 8.0);
+    }
+
+    SUBCASE("Remove root") {
+        root.reset();
+        left.reset();
+        right.reset();
+        CHECK(tree.remove_subtree(tree.get_root()));
+        CHECK(tree.get_root() == nullptr);
+        CHECK(tree.free_node_count() == 6);
+    }
+}
+
+TEST_CASE("Copy-on-Write Snapshots") {
+    Node<double> root_node(5.0);
+    Tree<double> tree;
+    tree.add_root(root_node);
+    Node<double> n1(3.0);
+    Node<double> n2(8.0);
+    Node<double> n3(1.0);
+    Node<double> n4(4.0);
+
+    tree.add_sub_node(root_node, n1);
+    tree.add_sub_node(root_node, n2);
+    tree.add_sub_node(n1, n3);
+    tree.add_sub_node(n1, n4);
+
+    auto view = tree.snapshot();
+    CHECK(view.get_root() == tree.get_root()); // Nothing is copied up front
+
+    SUBCASE("Add copies only the path") {
+        Node<double> n5(7.0);
+        tree.add_sub_node(n2, n5);
+        CHECK(view.get_root()->children[1]->children.empty());
+        CHECK(tree.get_root()->children[1]->children.size() == 1);
+        CHECK(view.get_root() != tree.get_root());
+        CHECK(view.get_root()->children[0] == tree.get_root()->children[0]); // Untouched subtree is shared
+    }
+
+    SUBCASE("Heap does not change the snapshot") {
+        tree.myHeap();
+        vector<double> expected = {5.0, 3.0, 8.0, 1.0, 4.0};
+        auto it = view.begin_bfs_scan();
+        for (double val : expected) {
+            CHECK((*it)->get_value() == val);
+            ++it;
+        }
+        CHECK(tree.get_root()->get_value() == 1.0);
+    }
+
+    SUBCASE("Removal does not change the snapshot") {
+        CHECK(tree.remove_subtree(tree.find_node(tree.get_root(), n1)));
+        CHECK(tree.get_root()->children.size() == 1);
+        CHECK(view.get_root()->children.size() == 2);
+        CHECK(view.get_root()->children[0]->children.size() == 2);
+        CHECK(tree.free_node_count() == 0); // Nodes still owned by the snapshot are not recycled
+    }
+
+    SUBCASE("Stale handles are rejected") {
+        auto old_left = view.get_root()->children[0];
+        Node<double> n5(7.0);
+        tree.add_sub_node(n3, n5); // Copies the path through the left child
+        CHECK_THROWS(tree.emplace_child(old_left->children[0], 9.0)); // Replaced by its copy in the live tree
+        CHECK(tree.emplace_child(old_left->children[1], 9.0) != nullptr); // Still shared, so still current
+        CHECK(view.get_root()->children[0]->children[0]->children.empty());
+        CHECK(view.get_root()->children[0]->children[1]->children.empty());
+    }
+
+    SUBCASE("Writes are in place once snapshots are gone") {
+        view = Tree<double>();
+        auto root = tree.get_root().get();
+        Node<double> n5(7.0);
+        tree.add_sub_node(n2, n5);
+        CHECK(tree.get_root().get() == root);
+    }
+}
+
+TEST_CASE("Tree Version") {
+    Tree<double> tree;
+    std::size_t version = tree.version();
+    auto root = tree.emplace_root(1.0);
+    CHECK(tree.version() != version);
+
+    version = tree.version();
+    auto left = tree.emplace_child(root, 2.0);
+    auto right = tree.emplace_child(root, 3.0);
+    CHECK(tree.version() == version + 2);
+
+    version = tree.version();
+    CHECK(tree.emplace_child(root, 4.0) == nullptr); // Nothing added, nothing changed
+    tree.snapshot();
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+        (*it)->get_value();
+    }
+    CHECK(tree.version() == version);
+
+    auto detached = tree.detach(right);
+    CHECK(tree.version() == version + 1);
+    CHECK(tree.reattach(left, detached));
+    CHECK(tree.version() == version + 2);
+    CHECK(tree.remove_subtree(detached));
+    CHECK(tree.version() == version + 3);
+    CHECK_FALSE(tree.remove_subtree(detached)); // No longer in the tree
+    CHECK(tree.version() == version + 3);
+
+    version = tree.version();
+    tree.myHeap();
+    CHECK(tree.version() != version);
+    version = tree.version();
+    tree.compact();
+    CHECK(tree.version() != version);
+    version = tree.version();
+    tree.get_root()->set_value(5.0); // Invisible to the tree until touch()
+    CHECK(tree.version() == version);
+    tree.touch();
+    CHECK(tree.version() != version);
+}
+
+TEST_CASE("Operation Counters") {
+    Tree<double> tree;
+    vector<shared_ptr<Node<double>>> nodes(1, tree.emplace_root(0.0));
+    for (int i = 1; i < 7; ++i) {
+        nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], double(i))); // Complete, values in BFS order
+    }
+    CHECK(tree.stats().allocations == 7);
+    CHECK(tree.stats().reuses == 0);
+
+    tree.reset_stats();
+    CHECK(tree.stats().allocations == 0);
+    size_t visited = 0;
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) ++visited;
+    CHECK(visited == 7);
+    TreeStats stats = tree.stats();
+    CHECK(stats.traversals == 1);
+    CHECK(stats.nodes_visited == 7);
+    CHECK(stats.pointer_copies == 2 + 6 + 6); // Root in and out, each child enqueued and dequeued
+
+    for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) {}
+    for (auto it = tree.begin_in_order(); it != tree.end_in_order(); ++it) {}
+    for (auto it = tree.begin_post_order(); it != tree.end_post_order(); ++it) {}
+    for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) {}
+    CHECK(tree.stats().traversals == 5);
+    CHECK(tree.stats().nodes_visited == 5 * 7);
+
+    tree.reset_stats();
+    CHECK(tree.find_node(tree.get_root(), Node<double>(6.0)) == nodes[6]);
+    CHECK(tree.stats().find_comparisons == 7); // 6 is last in pre-order
+    tree.reset_stats();
+    tree.add_sub_node(Node<double>(3.0), Node<double>(7.0));
+    CHECK(tree.stats().find_comparisons == 3); // 0, 1, 3
+    CHECK(tree.stats().allocations == 1);
+
+    tree.reset_stats();
+    tree.myHeap();
+    CHECK(tree.stats().heap_pushes == 8);
+    CHECK(tree.stats().heap_pops == 8);
+
+    tree.reset_stats();
+    CHECK(tree.remove_subtree(std::move(nodes[6]))); // No other handle left, so the node is recycled
+    tree.emplace_child(nodes[2], 9.0);
+    CHECK(tree.stats().reuses == 1);
+    CHECK(tree.stats().allocations == 0);
+
+    Tree<double> empty;
+    for (auto it = empty.begin_bfs_scan(); it != empty.end_bfs_scan(); ++it) {}
+    CHECK(empty.stats().traversals == 0);
+}
+
+TEST_CASE("Memory Usage") {
+    typedef shared_ptr<Node<double>> Link;
+    Tree<double> empty;
+    CHECK(empty.memory_usage().total() == 0);
+    CHECK(empty.memory_usage().per_node(0) == 0);
+
+    Tree<double> tree;
+    vector<Link> nodes(1, tree.emplace_root(0.0));
+    for (int i = 1; i < 7; ++i) {
+        nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], double(i)));
+    }
+    size_t link_capacity = 0;
+    for (const auto& node : nodes) link_capacity += node->children.capacity();
+
+    TreeMemory usage = tree.memory_usage();
+    CHECK(usage.nodes == 7);
+    CHECK(usage.payload == 7 * sizeof(double));
+    CHECK(usage.child_links == 7 * sizeof(vector<Link>) + link_capacity * sizeof(Link));
+    CHECK(usage.control > 7 * (sizeof(Node<double>) - sizeof(double) - sizeof(vector<Link>))); // Plus control blocks
+    CHECK(usage.allocations == 7 + 3); // A block per node and per non-empty children buffer
+    CHECK(usage.allocator > 0);
+    CHECK(usage.free_list == 0);
+    CHECK(usage.total() == usage.payload + usage.child_links + usage.control + usage.allocator);
+    CHECK(usage.per_node(usage.payload) == sizeof(double));
+
+    SUBCASE("Compaction drops the per-node blocks") {
+        tree.compact();
+        TreeMemory compacted = tree.memory_usage();
+        CHECK(compacted.nodes == 7);
+        CHECK(compacted.payload == usage.payload);
+        CHECK(compacted.allocations == 3 + 3); // The arena owner, its vector and nodes, and the children buffers
+        CHECK(compacted.control < usage.control);
+        CHECK(compacted.total() < usage.total());
+    }
+
+    SUBCASE("Removed nodes move to the free list") {
+        nodes.resize(3);
+        CHECK(tree.remove_subtree(std::move(nodes[2]))); // Node 2 and its children 5 and 6
+        TreeMemory removed = tree.memory_usage();
+        CHECK(removed.nodes == 4);
+        CHECK(removed.free_list > 0);
+        tree.release_free_nodes();
+        CHECK(tree.memory_usage().free_list == 0);
+        CHECK(tree.memory_usage().total() == removed.total() - removed.free_list);
+    }
+}
+
+struct HeapKeyed { // A value with its own order_key(), so myHeap caches the key next to it
+    double value;
+    explicit operator double() const { return value; }
+};
+
+double order_key(const HeapKeyed& keyed) {
+    return keyed.value;
+}
+
+template <typename V>
+size_t heap_bytes() { // Bytes myHeap allocates on a complete tree of 1024 values
+    Tree<V> tree;
+    vector<shared_ptr<Node<V>>> nodes(1, tree.emplace_root(V{1023.0}));
+    for (int i = 1; i < 1024; ++i) {
+        nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], V{double(1023 - i)}));
+    }
+    AllocationScope scope;
+    tree.myHeap();
+    CHECK(double(tree.get_root()->get_value()) == 0.0);
+    return scope.bytes();
+}
+
+TEST_CASE("Allocation Budgets") {
+    string long_value(100, 'x'); // Too long for the small string buffer, so every copy allocates
+
+    SUBCASE("Insertions copy nothing they can move") {
+        Tree<string> tree;
+        Node<string> root_node(long_value + "0");
+        tree.add_root(root_node);
+        Node<string> moved(long_value + "1");
+        Node<string> copied(long_value + "2");
+        {
+            AllocationBudget budget(2); // The node, and the root's first child link
+            tree.add_sub_node(root_node, std::move(moved));
+        }
+        {
+            AllocationBudget budget(3); // The node, a larger children buffer, and the copied string
+            tree.add_sub_node(root_node, copied);
+        }
+        {
+            AllocationBudget budget(3); // The node, the string built in place, and the parent's first child link
+            tree.emplace_child(tree.get_root()->children[0], long_value);
+        }
+    }
+
+    SUBCASE("Reused nodes keep their buffers") {
+        Tree<string> tree;
+        auto root = tree.emplace_root("root");
+        auto grow = [&tree, &root] { // A node with two children, values short enough to stay in the string
+            auto node = tree.emplace_child(root, "node");
+            tree.emplace_child(node, "left");
+            tree.emplace_child(node, "right");
+            return node;
+        };
+        auto node = grow();
+        for (int cycle = 0; cycle < 3; ++cycle) {
+            CHECK(tree.remove_subtree(std::move(node)));
+            CHECK(tree.free_node_count() == 3);
+            {
+                AllocationBudget budget(0); // Nodes, children buffers and the root's child link are all reused
+                node = grow();
+            }
+            CHECK(tree.free_node_count() == 0);
+        }
+        CHECK(node->children[1]->get_value() == "right");
+    }
+
+    SUBCASE("myHeap stores each value once") {
+        CHECK(heap_bytes<double>() + 1024 * sizeof(double) <= heap_bytes<HeapKeyed>()); // Keyed entries carry the key too
+    }
+
+    SUBCASE("Reads do not allocate") {
+        Tree<double> tree;
+        vector<shared_ptr<Node<double>>> nodes(1, tree.emplace_root(0.0));
+        for (int i = 1; i < 1000; ++i) {
+            nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], double(i)));
+        }
+        {
+            AllocationBudget budget(0);
+            CHECK(tree.find_node(tree.get_root(), Node<double>(999.0)) == nodes.back());
+            CHECK(tree.version() > 0);
+        }
+        {
+            AllocationBudget budget(1); // The shared version marker, nodes are not copied
+            auto view = tree.snapshot();
+        }
+        TextBuffer buffer;
+        {
+            AllocationBudget budget(16); // The traversal stack grows a few times, the buffer already fits
+            dump(tree, Traversal::DFS, buffer);
+        }
+    }
+
+    SUBCASE("memory_usage() counts the heap blocks") {
+        vector<shared_ptr<Node<double>>> nodes;
+        nodes.reserve(7);
+        AllocationScope scope;
+        Tree<double> tree;
+        nodes.push_back(tree.emplace_root(0.0));
+        for (int i = 1; i < 7; ++i) {
+            nodes.push_back(tree.emplace_child(nodes[(i - 1) / 2], double(i)));
+        }
+        size_t made = scope.allocations();
+        CHECK(tree.memory_usage().allocations == made - 3); // Less the children buffers outgrown by the second child
+    }
+}
+
+TEST_CASE("Succinct Tree") {
+    Node<double> root_node(1.0);
+    Tree<double, 3> tree;
+    tree.add_root(root_node);
+    Node<double> n1(2.0);
+    Node<double> n2(3.0);
+    Node<double> n3(4.0);
+    Node<double> n4(5.0);
+    Node<double> n5(6.0);
+
+    tree.add_sub_node(root_node, n1);
+    tree.add_sub_node(root_node, n2);
+    tree.add_sub_node(root_node, n3);
+    tree.add_sub_node(n1, n4);
+    tree.add_sub_node(n1, n5);
+
+    SuccinctTree<double> succinct(tree);
+    CHECK(succinct.size() == 6);
+
+    SUBCASE("Pre-Order Traversal") {
+        vector<double> expected = {1.0, 2.0, 5.0, 6.0, 3.0, 4.0};
+        auto it = succinct.begin_pre_order();
+        for (double val : expected) {
+            CHECK(*it == val);
+            ++it;
+        }
+        CHECK_FALSE(it != succinct.end_pre_order());
+    }
+
+    SUBCASE("BFS Traversal") {
+        vector<double> expected = {1.0, 2.0, 3.0, 4.0, 5.0, 6.0};
+        auto it = succinct.begin_bfs_scan();
+        for (double val : expected) {
+            CHECK(*it == val);
+            ++it;
+        }
+        CHECK_FALSE(it != succinct.end_bfs_scan());
+    }
+
+    SUBCASE("Navigation") {
+        CHECK(succinct.parent(0) == SuccinctTree<double>::npos);
+        CHECK(succinct.parent(2) == 1);
+        CHECK(succinct.parent(4) == 0);
+        CHECK(succinct.child_count(0) == 3);
+        CHECK(succinct.child(0, 2) == 5);
+        CHECK(succinct.child(0, 3) == SuccinctTree<double>::npos);
+        CHECK(succinct.first_child(1) == 2);
+        CHECK(succinct.next_sibling(1) == 4);
+        CHECK(succinct.next_sibling(5) == SuccinctTree<double>::npos);
+        CHECK(succinct.subtree_size(0) == 6);
+        CHECK(succinct.subtree_size(1) == 3);
+        CHECK(succinct.is_leaf(3));
+        CHECK(succinct.depth(3) == 2);
+        CHECK(succinct.value(4) == 3.0);
+    }
+
+    SUBCASE("Large trees match the pointer tree") {
+        Tree<double, 4> big; // Random shape with a long chain to exercise the block level searches
+        vector<shared_ptr<Node<double>>> nodes(1, big.emplace_root(0.0));
+        unsigned seed = 12345;
+        for (int i = 1; i < 20000; ++i) {
+            seed = seed * 1103515245u + 12345u;
+            auto parent = i < 5000 ? nodes.back() : nodes[(seed >> 8) % nodes.size()];
+            auto child = big.emplace_child(parent, double(i));
+            if (child) nodes.push_back(child);
+        }
+        SuccinctTree<double> encoded(big);
+        CHECK(encoded.size() == nodes.size());
+
+        vector<Node<double>*> order; // Pre-order ids of the pointer tree
+        for (auto it = big.begin_dfs_scan(); it != big.end_dfs_scan(); ++it) order.push_back(*it);
+        size_t mismatches = 0;
+        for (size_t id = 0; id < order.size(); id += 7) {
+            if (encoded.value(id) != order[id]->get_value()) ++mismatches;
+            if (encoded.child_count(id) != order[id]->children.size()) ++mismatches;
+            size_t child = encoded.first_child(id);
+            for (const auto& expected : order[id]->children) {
+                if (child == SuccinctTree<double>::npos || encoded.value(child) != expected->get_value()) ++mismatches;
+                else if (encoded.parent(child) != id) ++mismatches;
+                child = child == SuccinctTree<double>::npos ? child : encoded.next_sibling(child);
+            }
+        }
+        CHECK(mismatches == 0);
+        CHECK(encoded.subtree_size(0) == nodes.size());
+        CHECK(encoded.depth(4999) == 4999);
+        CHECK(encoded.parent(4999) == 4998);
+        CHECK(encoded.structure_bytes() * 8 < 3 * encoded.size()); // Under 3 bits per node
+
+        size_t visited = 0;
+        auto bfs = big.begin_bfs_scan();
+        for (auto it = encoded.begin_bfs_scan(); it != encoded.end_bfs_scan(); ++it, ++bfs) {
+            if (*it == bfs->get_value()) ++visited;
+        }
+        CHECK(visited == nodes.size());
+    }
+
+    SUBCASE("Sizes at word and block boundaries") {
+        for (size_t n : {32, 63, 64, 65, 96, 512, 1024}) { // 2n parentheses, a multiple of 64 ends on a word boundary
+            Tree<double> complete;
+            vector<shared_ptr<Node<double>>> nodes(1, complete.emplace_root(0.0));
+            for (size_t i = 1; i < n; ++i) {
+                nodes.push_back(complete.emplace_child(nodes[(i - 1) / 2], double(i))); // Values are BFS indices
+            }
+            SuccinctTree<double> encoded(complete);
+            vector<size_t> sizes(n, 1); // Counted by brute force, children come after their parent in BFS order
+            for (size_t i = n - 1; i > 0; --i) sizes[(i - 1) / 2] += sizes[i];
+
+            size_t mismatches = 0;
+            for (size_t id = 0; id < n; ++id) {
+                size_t index = size_t(encoded.value(id));
+                if (encoded.subtree_size(id) != sizes[index]) ++mismatches;
+                size_t sibling = index % 2 == 1 && index + 1 < n ? index + 1 : 0; // Left children have a right sibling
+                size_t next = encoded.next_sibling(id);
+                if (sibling ? next == SuccinctTree<double>::npos || encoded.value(next) != sibling : next != SuccinctTree<double>::npos) {
+                    ++mismatches;
+                }
+            }
+            INFO("n = " << n);
+            CHECK(mismatches == 0);
+            CHECK(encoded.subtree_size(0) == n);
+        }
+    }
+}
+
+TEST_CASE("Complex Ordering") {
+    Complex a(3.0, 4.0);
+    Complex b(4.0, 3.0);
+    Complex c(1.0, 7.0);
+    CHECK(a.norm() == 25.0);
+    CHECK(a.magnitude() == 5.0);
+    CHECK(order_key(c) == 50.0);
+    CHECK(a < c);
+    CHECK(c > b);
+    CHECK(a <= b);
+    CHECK(a >= b);
+    CHECK_FALSE(a < b); // Equal magnitudes
+    CHECK(a != b);
+}
+
+template <typename F>
+size_t kernel_mismatches(SimdLevel level) { // Compares every BasicComplexArray kernel with BasicComplex arithmetic
+    typedef BasicComplex<F> C;
+    BasicComplexArray<F> a, b;
+    for (int i = 0; i < 19; ++i) { // Odd size so every kernel also runs its scalar tail
+        a.push_back(C(F(1.5 * i - 4.0), F(0.25 * i + 1.0)));
+        b.push_back(C(F(2.0 - 0.5 * i), F(3.0 - i)));
+    }
+    BasicComplexArray<F>::force_simd(level);
+    BasicComplexArray<F> sum = a + b, difference = a - b, product = a * b, quotient = a / b;
+    vector<F> magnitudes;
+    vector<unsigned char> less;
+    BasicComplexArray<F>::magnitude(a, magnitudes);
+    BasicComplexArray<F>::less_magnitude(a, b, less);
+    BasicComplexArray<F>::force_simd(BasicComplexArray<F>::supported_simd());
+
+    size_t mismatches = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (sum[i] != a[i] + b[i]) ++mismatches;
+        if (difference[i] != a[i] - b[i]) ++mismatches;
+        if (product[i] != a[i] * b[i]) ++mismatches;
+        if (quotient[i] != a[i] / b[i]) ++mismatches;
+        if (magnitudes[i] != a[i].magnitude()) ++mismatches;
+        if (bool(less[i]) != (a[i] < b[i])) ++mismatches;
+    }
+    return mismatches;
+}
+
+TEST_CASE("ComplexArray Kernels") {
+    SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::SSE2, SimdLevel::AVX2};
+    for (SimdLevel level : levels) {
+        CAPTURE(static_cast<int>(level));
+        CHECK(kernel_mismatches<double>(level) == 0);
+        CHECK(kernel_mismatches<float>(level) == 0);
+    }
+
+    ComplexArray shorter(3), longer(4);
+    CHECK_THROWS(shorter + longer);
+}
+
+TEST_CASE("ComplexArray Gather and Scatter") {
+    Tree<Complex> tree;
+    auto root = tree.emplace_root(1.0, 1.0);
+    auto left = tree.emplace_child(root, 2.0, 2.0);
+    tree.emplace_child(root, 3.0, 3.0);
+    tree.emplace_child(left, 4.0, 4.0);
+
+    ComplexArray values;
+    values.gather(tree, Order::BFS);
+    CHECK(values.size() == 4);
+    CHECK(values[2] == Complex(3.0, 3.0));
+    CHECK(values[3] == Complex(4.0, 4.0));
+
+    ComplexArray doubled = values + values;
+    auto view = tree.snapshot();
+    size_t version = tree.version();
+    doubled.scatter(tree, Order::BFS);
+    CHECK(tree.version() != version);
+    vector<Complex> expected = {Complex(2.0, 2.0), Complex(4.0, 4.0), Complex(8.0, 8.0), Complex(6.0, 6.0)};
+    auto it = tree.begin_dfs_scan();
+    for (Complex val : expected) {
+        CHECK((*it)->get_value() == val);
+        ++it;
+    }
+    ComplexArray before;
+    before.gather(view, Order::BFS); // The snapshot still shows the values it was taken with
+    for (size_t i = 0; i < values.size(); ++i) CHECK(before[i] == values[i]);
+}
+
+TEST_CASE("Single Precision Complex Trees") {
+    CHECK(sizeof(ComplexF) == sizeof(Complex) / 2);
+
+    Tree<ComplexF> tree;
+    auto root = tree.emplace_root(3.4f, 5.2f);
+    auto left = tree.emplace_child(root, 7.1f, 8.3f);
+    auto right = tree.emplace_child(root, 1.2f, 3.4f);
+    tree.emplace_child(left, 2.9f, 4.1f);
+    tree.emplace_child(left, 5.6f, 1.1f);
+    tree.emplace_child(right, 2.5f, 9.8f);
+
+    tree.myHeap();
+    vector<ComplexF> expected = {ComplexF(1.2f, 3.4f), ComplexF(2.9f, 4.1f), ComplexF(5.6f, 1.1f),
+                                 ComplexF(3.4f, 5.2f), ComplexF(2.5f, 9.8f), ComplexF(7.1f, 8.3f)};
+    auto it = tree.begin_bfs_scan();
+    for (ComplexF val : expected) {
+        CHECK((*it)->get_value() == val);
+        ++it;
+    }
+
+    ComplexArrayF values;
+    values.gather(tree, Order::BFS);
+    vector<float> magnitudes;
+    ComplexArrayF::magnitude(values, magnitudes);
+    CHECK(magnitudes[0] == ComplexF(1.2f, 3.4f).magnitude());
+}
+
+TEST_CASE("Constexpr Complex Arithmetic") {
+    constexpr Complex a(1.0, 2.0);
+    constexpr Complex b(3.0, 4.0);
+    constexpr Complex product = a * b;
+    static_assert(product.getReal() == -5.0 && product.getImag() == 10.0, "evaluated at compile time");
+    static_assert((a + b).norm() == 52.0, "evaluated at compile time");
+    static_assert(a < b, "evaluated at compile time");
+    static_assert(noexcept(a / b), "arithmetic does not throw");
+
+    CHECK(a.multiply_add(b, Complex(1.0, 1.0)) == a * b + Complex(1.0, 1.0));
+    CHECK(a.multiply_conjugate(b) == a * b.conj());
+    CHECK(b.reciprocal() == Complex(1.0, 0.0) / b);
+    CHECK(ComplexF(2.0f, 0.0f).reciprocal() == ComplexF(0.5f, 0.0f));
+}
+
+TEST_CASE("Compiled Complex Expressions") {
+    // ((x + 2) * (y - (1 + 1i))) / x
+    Tree<ExprToken> tree;
+    auto divide = tree.emplace_root(ExprOp::Divide);
+    auto multiply = tree.emplace_child(divide, ExprOp::Multiply);
+    tree.emplace_child(divide, ExprToken::input(0));
+    auto add = tree.emplace_child(multiply, ExprOp::Add);
+    auto subtract = tree.emplace_child(multiply, ExprOp::Subtract);
+    tree.emplace_child(add, ExprToken::input(0));
+    tree.emplace_child(add, ExprToken::constant(Complex(2.0, 0.0)));
+    tree.emplace_child(subtract, ExprToken::input(1));
+    tree.emplace_child(subtract, ExprToken::constant(Complex(1.0, 1.0)));
+
+    Expression expression(tree);
+    CHECK(expression.variable_count() == 2);
+    CHECK(expression.instruction_count() == 9);
+
+    SUBCASE("Single evaluation") {
+        vector<Complex> binding = {Complex(1.0, 2.0), Complex(3.0, -1.0)};
+        Complex x = binding[0], y = binding[1];
+        Complex expected = ((x + Complex(2.0, 0.0)) * (y - Complex(1.0, 1.0))) / x;
+        CHECK(expression.evaluate(binding) == expected);
+        CHECK(Expression::walk(tree, binding) == expected);
+        CHECK_THROWS(expression.evaluate(vector<Complex>(1)));
+    }
+
+    SUBCASE("Batch evaluation") {
+        vector<ComplexArray> bindings(2);
+        for (int i = 0; i < 2500; ++i) { // Spans several chunks
+            bindings[0].push_back(Complex(0.5 * i + 1.0, 1.0 - 0.25 * i));
+            bindings[1].push_back(Complex(2.0 - i, 0.125 * i));
+        }
+        ComplexArray results;
+        expression.evaluate(bindings, results);
+        CHECK(results.size() == 2500);
+        size_t mismatches = 0;
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (results[i] != expression.evaluate({bindings[0][i], bindings[1][i]})) ++mismatches;
+        }
+        CHECK(mismatches == 0);
+    }
+
+    SUBCASE("Constant folding") {
+        Tree<ExprToken> folded; // (2 + 3i) * x, with the constant built from a subtree
+        auto root = folded.emplace_root(ExprOp::Multiply);
+        auto constant = folded.emplace_child(root, ExprOp::Add);
+        folded.emplace_child(root, ExprToken::input(0));
+        folded.emplace_child(constant, ExprToken::constant(Complex(2.0, 0.0)));
+        folded.emplace_child(constant, ExprToken::constant(Complex(0.0, 3.0)));
+        Expression compiled(folded);
+        CHECK(compiled.instruction_count() == 3);
+        CHECK(compiled.evaluate({Complex(1.0, 1.0)}) == Complex(2.0, 3.0) * Complex(1.0, 1.0));
+    }
+
+    SUBCASE("Malformed trees") {
+        Tree<ExprToken> missing_operand;
+        auto root = missing_operand.emplace_root(ExprOp::Add);
+        missing_operand.emplace_child(root, ExprToken::input(0));
+        CHECK_THROWS(Expression(missing_operand));
+        CHECK_THROWS(Expression(Tree<ExprToken>()));
+    }
+}
+
+TEST_CASE("K-d Tree Queries") {
+    vector<Complex> points;
+    unsigned seed = 99;
+    for (int i = 0; i < 3000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        double real = double((seed >> 8) % 10000) / 100.0;
+        seed = seed * 1103515245u + 12345u;
+        points.push_back(Complex(real, double((seed >> 8) % 10000) / 100.0));
+    }
+    KdTree index(points);
+    CHECK(index.size() == points.size());
+    Complex query(37.5, 61.25);
+
+    SUBCASE("Nearest neighbours") {
+        auto found = index.nearest(query, 10);
+        REQUIRE(found.size() == 10);
+        vector<double> distances;
+        for (const auto& point : points) distances.push_back((point - query).norm());
+        sort(distances.begin(), distances.end());
+        for (size_t i = 0; i < found.size(); ++i) {
+            CHECK((found[i].point - query).norm() == distances[i]);
+            CHECK(points[found[i].index] == found[i].point);
+        }
+        CHECK(index.nearest(query, 0).empty());
+        CHECK(index.nearest(query, 5000).size() == points.size());
+    }
+
+    SUBCASE("Box query") {
+        Complex low(20.0, 30.0), high(35.0, 70.0);
+        size_t expected = 0;
+        for (const auto& point : points) {
+            if (point.getReal() >= 20.0 && point.getReal() <= 35.0 && point.getImag() >= 30.0 && point.getImag() <= 70.0) ++expected;
+        }
+        auto found = index.in_box(low, high);
+        CHECK(found.size() == expected);
+        for (const auto& entry : found) CHECK(entry.point.getReal() >= 20.0);
+    }
+
+    SUBCASE("Radius query") {
+        size_t expected = 0;
+        for (const auto& point : points) {
+            if ((point - query).magnitude() <= 8.0) ++expected;
+        }
+        CHECK(index.in_radius(query, 8.0).size() == expected);
+    }
+
+    SUBCASE("Built from a tree") {
+        Tree<Complex> tree;
+        auto root = tree.emplace_root(0.0, 0.0);
+        tree.emplace_child(root, 5.0, 5.0);
+        tree.emplace_child(root, 1.0, 1.0);
+        KdTree from_tree(tree);
+        auto found = from_tree.nearest(Complex(2.0, 2.0), 1);
+        REQUIRE(found.size() == 1);
+        CHECK(found[0].point == Complex(1.0, 1.0));
+        CHECK(found[0].index == 2); // BFS position
+    }
+}
+
+TEST_CASE("Complex Quadtree") {
+    ComplexQuadTree quadtree(Complex(50.0, 50.0), 50.0, 8);
+    vector<Complex> points;
+    unsigned seed = 7;
+    for (int i = 0; i < 2000; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        double real = double((seed >> 8) % 10000) / 100.0;
+        seed = seed * 1103515245u + 12345u;
+        points.push_back(Complex(real, double((seed >> 8) % 10000) / 100.0));
+        quadtree.insert(points.back());
+    }
+    CHECK(quadtree.size() == points.size());
+
+    SUBCASE("Region queries") {
+        Complex low(12.5, 40.0), high(60.0, 55.5);
+        size_t expected = 0;
+        for (const auto& point : points) {
+            if (point.getReal() >= 12.5 && point.getReal() <= 60.0 && point.getImag() >= 40.0 && point.getImag() <= 55.5) ++expected;
+        }
+        auto found = quadtree.query(low, high);
+        CHECK(found.size() == expected);
+        for (const auto& point : found) CHECK(point.getImag() <= 55.5);
+        CHECK(quadtree.count(low, high) == expected);
+        CHECK(quadtree.count(Complex(-1.0, -1.0), Complex(101.0, 101.0)) == points.size());
+    }
+
+    SUBCASE("Leaves are bucketed and cells split") {
+        size_t leaves = 0, stored = 0;
+        for (auto it = quadtree.cells().begin_bfs_scan(); it != quadtree.cells().end_bfs_scan(); ++it) {
+            const auto& cell = (*it)->get_value();
+            if ((*it)->children.empty()) {
+                ++leaves;
+                stored += cell.bucket.size();
+                CHECK(cell.bucket.size() <= 8);
+                CHECK(cell.bucket.size() == cell.count);
+            } else {
+                CHECK((*it)->children.size() == 4);
+                CHECK(cell.bucket.empty());
+            }
+        }
+        CHECK(leaves > 1);
+        CHECK(stored == points.size());
+    }
+
+    SUBCASE("Level of detail") {
+        auto top = quadtree.level_of_detail(0);
+        REQUIRE(top.size() == 1);
+        CHECK(top[0].count == points.size());
+        Complex sum;
+        for (const auto& point : points) sum = sum + point;
+        CHECK(top[0].centroid.getReal() == doctest::Approx(sum.getReal() / points.size()));
+        CHECK(top[0].centroid.getImag() == doctest::Approx(sum.getImag() / points.size()));
+        auto quadrants = quadtree.level_of_detail(1);
+        CHECK(quadrants.size() == 4);
+        size_t total = 0;
+        for (const auto& summary : quadtree.level_of_detail(3)) total += summary.count;
+        CHECK(total == points.size());
+    }
+
+    SUBCASE("Grows to fit points outside the bounds") {
+        quadtree.insert(Complex(-150.0, 320.0));
+        quadtree.insert(Complex(400.0, -20.0));
+        CHECK(quadtree.size() == points.size() + 2);
+        CHECK(quadtree.count(Complex(-200.0, 300.0), Complex(-100.0, 350.0)) == 1);
+        CHECK(quadtree.query(Complex(0.0, 0.0), Complex(100.0, 100.0)).size() == points.size());
+        auto root = quadtree.cells().get_root()->get_value();
+        CHECK(root.contains(Complex(-150.0, 320.0)));
+        CHECK(root.contains(Complex(400.0, -20.0)));
+    }
+
+    SUBCASE("Snapshots keep their cells") {
+        auto view = quadtree.cells().snapshot();
+        size_t cells = 0;
+        for (auto it = view.begin_bfs_scan(); it != view.end_bfs_scan(); ++it) ++cells;
+        for (const auto& point : points) quadtree.insert(point); // Splits leaves
+        quadtree.insert(Complex(-150.0, 320.0)); // Grows the root
+        CHECK(quadtree.size() == 2 * points.size() + 1);
+        CHECK(quadtree.count(Complex(0.0, 0.0), Complex(100.0, 100.0)) == 2 * points.size());
+        CHECK(view.get_root()->get_value().count == points.size());
+        CHECK_FALSE(view.get_root()->get_value().contains(Complex(-150.0, 320.0)));
+        size_t counted = 0, stored = 0;
+        for (auto it = view.begin_bfs_scan(); it != view.end_bfs_scan(); ++it) {
+            ++counted;
+            stored += (*it)->get_value().bucket.size();
+        }
+        CHECK(counted == cells);
+        CHECK(stored == points.size());
+    }
+
+    SUBCASE("Duplicates stop splitting at the depth limit") {
+        ComplexQuadTree small(Complex(0.0, 0.0), 1.0, 2, 5);
+        for (int i = 0; i < 20; ++i) small.insert(Complex(0.25, 0.25));
+        CHECK(small.size() == 20);
+        CHECK(small.count(Complex(0.2, 0.2), Complex(0.3, 0.3)) == 20);
+    }
+
+    SUBCASE("Rejects empty bounds") {
+        CHECK_THROWS_AS(ComplexQuadTree(Complex(0.0, 0.0), 0.0), invalid_argument);
+        CHECK_THROWS_AS(ComplexQuadTree(Complex(0.0, 0.0), -1.0), invalid_argument);
+        CHECK_THROWS_AS(ComplexQuadTree(Complex(0.0, 0.0), nan("")), invalid_argument);
+        CHECK_THROWS_AS(ComplexQuadTree(Complex(nan(""), 0.0), 1.0), invalid_argument);
+    }
+
+    SUBCASE("Rejects points that are not finite") {
+        CHECK_THROWS_AS(quadtree.insert(Complex(nan(""), 1.0)), invalid_argument);
+        CHECK_THROWS_AS(quadtree.insert(Complex(1.0, HUGE_VAL)), invalid_argument);
+        CHECK_THROWS_AS(quadtree.insert(Complex(-HUGE_VAL, 1.0)), invalid_argument);
+        CHECK(quadtree.size() == points.size());
+        quadtree.insert(Complex(1e300, -1e300)); // Far but finite, grows until it fits
+        CHECK(quadtree.size() == points.size() + 1);
+    }
+}
+
+TEST_CASE("Bulk Text Dump") {
+    Tree<double, 3> tree;
+    auto root = tree.emplace_root(0.5);
+    vector<shared_ptr<Node<double>>> nodes(1, root);
+    unsigned seed = 3;
+    for (int i = 1; i < 200; ++i) {
+        seed = seed * 1103515245u + 12345u;
+        auto parent = nodes[(seed >> 8) % nodes.size()];
+        auto child = tree.emplace_child(parent, i + 0.25);
+        if (child) nodes.push_back(child);
+    }
+
+    auto expected = [&tree](Traversal order) {
+        ostringstream text;
+        switch (order) {
+            case Traversal::PreOrder: for (auto it = tree.begin_pre_order(); it != tree.end_pre_order(); ++it) text << (*it)->get_value() << '\n'; break;
+            case Traversal::InOrder: for (auto it = tree.begin_in_order(); it != tree.end_in_order(); ++it) text << (*it)->get_value() << '\n'; break;
+            case Traversal::PostOrder: for (auto it = tree.begin_post_order(); it != tree.end_post_order(); ++it) text << (*it)->get_value() << '\n'; break;
+            case Traversal::BFS: for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) text << (*it)->get_value() << '\n'; break;
+            case Traversal::DFS: for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) text << (*it)->get_value() << '\n'; break;
+        }
+        return text.str();
+    };
+
+    SUBCASE("Every order matches the iterators") {
+        for (auto order : {Traversal::PreOrder, Traversal::InOrder, Traversal::PostOrder, Traversal::BFS, Traversal::DFS}) {
+            ostringstream text;
+            dump(text, tree, order);
+            CHECK(text.str() == expected(order));
+        }
+    }
+
+    SUBCASE("Precision and separators") {
+        Tree<double> small;
+        auto top = small.emplace_root(3.14159265);
+        small.emplace_child(top, -0.000125);
+        small.emplace_child(top, 1e21);
+        ostringstream shortest, rounded;
+        dump(shortest, small, Traversal::BFS);
+        dump(rounded, small, Traversal::BFS, 3, ' ');
+        CHECK(shortest.str() == "3.14159265\n-0.000125\n1e+21\n");
+        CHECK(rounded.str() == "3.14 -0.000125 1e+21 ");
+
+        unsigned value_seed = 17;
+        size_t mismatches = 0;
+        for (int precision = 0; precision <= 10; ++precision) {
+            for (int i = 0; i < 2000; ++i) {
+                value_seed = value_seed * 1103515245u + 12345u;
+                double value = double(value_seed >> 8) / (1 << 24) * pow(10.0, int(value_seed % 16) - 5);
+                if (i % 5 == 0) value = -double(i) / 8.0; // Exact ties such as 0.125
+                TextBuffer buffer(precision);
+                buffer.append(value);
+                char reference[64];
+                auto end = to_chars(reference, reference + 64, value, chars_format::general, precision).ptr;
+                if (string(buffer.data(), buffer.size()) != string(reference, end)) ++mismatches;
+            }
+        }
+        CHECK(mismatches == 0);
+    }
+
+    SUBCASE("Complex values use the operator<< layout") {
+        Tree<Complex> complex_tree;
+        auto top = complex_tree.emplace_root(1.5, -2.0);
+        complex_tree.emplace_child(top, 0.0, 4.25);
+        ostringstream text, streamed;
+        dump(text, complex_tree, Traversal::PreOrder);
+        for (auto it = complex_tree.begin_pre_order(); it != complex_tree.end_pre_order(); ++it) streamed << (*it)->get_value() << '\n';
+        CHECK(text.str() == streamed.str());
+        CHECK(text.str() == "1.5 + -2i\n0 + 4.25i\n");
+    }
+
+    SUBCASE("Buffer grows and can be reused") {
+        TextBuffer buffer(-1, 4);
+        dump(tree, Traversal::BFS, buffer);
+        CHECK(string(buffer.data(), buffer.size()) == expected(Traversal::BFS));
+        buffer.clear();
+        buffer.append(42);
+        buffer.append(' ');
+        buffer.append(string("text"));
+        CHECK(string(buffer.data(), buffer.size()) == "42 text");
+    }
+
+    SUBCASE("Empty tree") {
+        Tree<double> empty;
+        ostringstream text;
+        dump(text, empty, Traversal::InOrder);
+        CHECK(text.str().empty());
+    }
+}
+
+TEST_CASE("Tidy Tree Layout") {
+    auto check_tidy = [](const TreeLayout<double>& layout) {
+        const auto& entries = layout.entries();
+        for (size_t depth = 0; depth < layout.level_count(); ++depth) {
+            for (size_t i = layout.level_begin(depth); i < layout.level_begin(depth + 1); ++i) {
+                CHECK(entries[i].depth == depth);
+                if (i > layout.level_begin(depth)) CHECK(entries[i].x - entries[i - 1].x >= 1.0 - 1e-9); // No overlap
+            }
+        }
+        vector<size_t> first(entries.size(), TreeLayout<double>::npos), last(entries.size());
+        for (size_t i = 1; i < entries.size(); ++i) {
+            CHECK(entries[i].parent < i);
+            if (first[entries[i].parent] == TreeLayout<double>::npos) first[entries[i].parent] = i;
+            last[entries[i].parent] = i;
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            if (first[i] != TreeLayout<double>::npos) { // Parents are centred over their children
+                CHECK(entries[i].x == doctest::Approx((entries[first[i]].x + entries[last[i]].x) / 2));
+            }
+        }
+        const auto& subtrees = layout.subtrees();
+        REQUIRE(subtrees.size() == entries.size());
+        vector<size_t> sizes(entries.size(), 1);
+        vector<double> lefts(entries.size()), rights(entries.size());
+        for (size_t i = 0; i < entries.size(); ++i) lefts[i] = rights[i] = entries[i].x;
+        for (size_t i = entries.size(); i-- > 1;) {
+            sizes[entries[i].parent] += sizes[i];
+            lefts[entries[i].parent] = min(lefts[entries[i].parent], lefts[i]);
+            rights[entries[i].parent] = max(rights[entries[i].parent], rights[i]);
+        }
+        for (size_t i = 0; i < entries.size(); ++i) {
+            CHECK(subtrees[i].size == sizes[i]);
+            CHECK(subtrees[i].left == lefts[i]);
+            CHECK(subtrees[i].right == rights[i]);
+            CHECK(subtrees[i].child_count == (first[i] == TreeLayout<double>::npos ? 0 : last[i] - first[i] + 1));
+            if (subtrees[i].child_count > 0) CHECK(subtrees[i].first_child == first[i]);
+            CHECK(subtrees[i].bottom >= entries[i].depth);
+        }
+        if (!entries.empty()) {
+            CHECK(subtrees[0].size == entries.size());
+            CHECK(subtrees[0].bottom + 1 == layout.level_count());
+        }
+    };
+
+    SUBCASE("Small trees") {
+        Tree<double, 3> tree;
+        auto root = tree.emplace_root(1.0);
+        tree.emplace_child(root, 2.0);
+        tree.emplace_child(root, 3.0);
+        tree.emplace_child(root, 4.0);
+        TreeLayout<double> layout(tree);
+        REQUIRE(layout.size() == 4);
+        CHECK(layout.level_count() == 2);
+        CHECK(layout.entries()[0].x == 1.0);
+        CHECK(layout.entries()[1].x == 0.0);
+        CHECK(layout.entries()[3].x == 2.0);
+        CHECK(layout.entries()[3].node->get_value() == 4.0);
+        CHECK(layout.width() == 2.0);
+
+        Tree<double> empty;
+        TreeLayout<double> nothing(empty);
+        CHECK(nothing.size() == 0);
+        CHECK(nothing.level_count() == 0);
+    }
+
+    SUBCASE("Complete trees are symmetric") {
+        Tree<double> tree;
+        vector<shared_ptr<Node<double>>> nodes(1, tree.emplace_root(0.0));
+        for (size_t i = 0; nodes.size() < 127; ++i) {
+            nodes.push_back(tree.emplace_child(nodes[i], 1.0));
+            nodes.push_back(tree.emplace_child(nodes[i], 2.0));
+        }
+        TreeLayout<double> layout(tree);
+        check_tidy(layout);
+        CHECK(layout.entries()[0].x == layout.width() / 2);
+        CHECK(layout.width() == 63.0); // 64 leaves side by side
+    }
+
+    SUBCASE("Random trees and incremental relayout") {
+        Tree<double, 4> tree;
+        vector<shared_ptr<Node<double>>> nodes(1, tree.emplace_root(0.0));
+        unsigned seed = 21;
+        auto next = [&seed](size_t bound) { seed = seed * 1103515245u + 12345u; return size_t(seed >> 8) % bound; };
+        for (int i = 1; i < 600; ++i) {
+            auto child = tree.emplace_child(nodes[next(nodes.size())], double(i));
+            if (child) nodes.push_back(child);
+        }
+        TreeLayout<double> layout(tree);
+        check_tidy(layout);
+
+        for (int round = 0; round < 40; ++round) {
+            auto target = nodes[next(nodes.size())];
+            if (round % 3 == 2 && !target->children.empty()) {
+                tree.remove_subtree(target->children[next(target->children.size())]);
+            } else {
+                for (int i = 0; i < 3; ++i) {
+                    auto parent = target;
+                    for (int step = 0; step < 2 && !parent->children.empty(); ++step) parent = parent->children[next(parent->children.size())];
+                    auto child = tree.emplace_child(parent, 1000.0 + round);
+                    if (child) nodes.push_back(child);
+                }
+            }
+            layout.relayout(tree, target);
+            TreeLayout<double> fresh(tree);
+            REQUIRE(layout.size() == fresh.size());
+            size_t mismatches = 0;
+            for (size_t i = 0; i < fresh.size(); ++i) {
+                if (layout.entries()[i].node != fresh.entries()[i].node || layout.entries()[i].parent != fresh.entries()[i].parent ||
+                    std::abs(layout.entries()[i].x - fresh.entries()[i].x) > 1e-9) ++mismatches;
+            }
+            CHECK(mismatches == 0);
+            // Removed subtrees stay in nodes, keep only handles still in the tree
+            vector<shared_ptr<Node<double>>> alive;
+            for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+                for (const auto& node : nodes) if (node.get() == *it) { alive.push_back(node); break; }
+            }
+            nodes.swap(alive);
+        }
+        check_tidy(layout);
+    }
+
+    SUBCASE("Relayout after a copy-on-write edit") {
+        Tree<double> tree;
+        auto root = tree.emplace_root(0.0);
+        auto left = tree.emplace_child(root, 1.0);
+        tree.emplace_child(root, 2.0);
+        TreeLayout<double> layout(tree);
+        auto snapshot = tree.snapshot();
+        tree.emplace_child(left, 3.0); // Copies root and left, the layout still knows the old nodes
+        tree.emplace_child(tree.get_root()->children[0], 4.0);
+        layout.relayout(tree, left);
+        TreeLayout<double> fresh(tree);
+        REQUIRE(layout.size() == 5);
+        for (size_t i = 0; i < fresh.size(); ++i) {
+            CHECK(layout.entries()[i].node == fresh.entries()[i].node);
+            CHECK(layout.entries()[i].x == fresh.entries()[i].x);
+        }
+        CHECK_THROWS_AS(layout.relayout(tree, make_shared<Node<double>>(5.0)), invalid_argument);
+    }
+}
+
+struct Tag { // Value type with no stream operator, labelled through TextFormat
+    int id;
+    Tag(int id) : id(id) {}
+};
+
+template <>
+struct TextFormat<Tag> {
+    static void write(TextBuffer& out, const Tag& tag) {
+        out.append('#');
+        out.append(tag.id);
+    }
+};
+
+TEST_CASE("Custom Text Format") {
+    Tree<Tag> tree;
+    auto root = tree.emplace_root(1);
+    tree.emplace_child(root, 2);
+    tree.emplace_child(root, 3);
+
+    ostringstream dumped;
+    dump(dumped, tree, Traversal::BFS, -1, ' ');
+    CHECK(dumped.str() == "#1 #2 #3 ");
+
+    ostringstream svg;
+    write_svg(svg, tree);
+    CHECK(svg.str().find(">#2</text>") != string::npos);
+}
+
+TEST_CASE("Headless Export") {
+    Tree<Complex> tree;
+    auto root = tree.emplace_root(1.0, 1.0);
+    auto left = tree.emplace_child(root, 2.0, 2.0);
+    auto right = tree.emplace_child(root, 3.0, 3.0);
+    tree.emplace_child(left, 4.0, 4.0);
+    tree.emplace_child(left, 5.0, 5.0);
+    tree.emplace_child(right, 6.0, 6.0);
+    TreeLayout<Complex> layout(tree);
+    ExportFrame frame(layout, ExportStyle());
+
+    auto count = [](const string& text, const string& pattern) {
+        size_t found = 0;
+        for (size_t at = text.find(pattern); at != string::npos; at = text.find(pattern, at + 1)) ++found;
+        return found;
+    };
+
+    SUBCASE("SVG") {
+        ostringstream os;
+        write_svg(os, tree);
+        string svg = os.str();
+        CHECK(svg.compare(0, 5, "<?xml") == 0);
+        CHECK(svg.find("</svg>\n") == svg.size() - 7);
+        CHECK(count(svg, "<circle") == 6);
+        CHECK(count(svg, "<path") == 1);
+        CHECK(count(svg, "M") == 5); // One move per edge
+        CHECK(svg.find(">1 + 1i</text>") != string::npos);
+        CHECK(svg.find(">6 + 6i</text>") != string::npos);
+
+        ExportStyle plain;
+        plain.labels = false;
+        ostringstream unlabelled;
+        write_svg(unlabelled, layout, plain);
+        CHECK(count(unlabelled.str(), "<text") == 0);
+
+        Tree<string> strings;
+        strings.emplace_root("<a&b>");
+        ostringstream escaped;
+        write_svg(escaped, strings);
+        CHECK(escaped.str().find(">&lt;a&amp;b&gt;</text>") != string::npos);
+    }
+
+    SUBCASE("PPM") {
+        ostringstream os;
+        write_ppm(os, tree);
+        string ppm = os.str();
+        string header = "P6\n" + to_string(frame.width) + " " + to_string(frame.height) + "\n255\n";
+        REQUIRE(ppm.compare(0, header.size(), header) == 0);
+        REQUIRE(ppm.size() == header.size() + frame.width * frame.height * 3);
+        auto pixel = [&](double x, double y) {
+            size_t at = header.size() + (size_t(y) * frame.width + size_t(x)) * 3;
+            return (unsigned char)ppm[at] * 65536 + (unsigned char)ppm[at + 1] * 256 + (unsigned char)ppm[at + 2];
+        };
+        const int white = 0xFFFFFF, black = 0, red = 0xFF0000;
+        CHECK(pixel(0, 0) == white);
+        double root_x = frame.x(layout.entries()[0].x), root_y = frame.y(0);
+        CHECK(pixel(root_x, root_y - frame.radius + 0.5) == black); // Top of the outline
+        CHECK(pixel(root_x, root_y - frame.radius / 2) == white); // Inside, above the label
+        double child_x = frame.x(layout.entries()[1].x), child_y = frame.y(1);
+        CHECK(pixel(child_x, child_y - frame.radius + 0.5) == black); // The circle crosses a strip boundary
+        CHECK(pixel(child_x, child_y + frame.radius - 0.5) == black);
+        size_t reds = 0;
+        for (size_t x = 0; x < frame.width; ++x) {
+            if (pixel(x, (root_y + child_y) / 2) == red) ++reds;
+        }
+        CHECK(reds >= 2); // Both edges leaving the root
+    }
+
+    SUBCASE("Fit to a size") {
+        Tree<double> big;
+        vector<shared_ptr<Node<double>>> nodes(1, big.emplace_root(0.0));
+        unsigned seed = 3;
+        for (int i = 1; i < 20000; ++i) {
+            seed = seed * 1103515245 + 12345;
+            auto child = big.emplace_child(nodes[(seed >> 8) % nodes.size()], double(i));
+            if (child) nodes.push_back(child);
+        }
+        ExportStyle style;
+        style.max_width = 800;
+        style.max_height = 600;
+        TreeLayout<double> big_layout(big);
+        ExportFrame fitted(big_layout, style);
+        CHECK(fitted.width <= 800);
+        CHECK(fitted.height <= 600);
+        CHECK(fitted.scale < 1);
+        ostringstream os;
+        write_ppm(os, big_layout, style);
+        CHECK(os.str().size() > fitted.width * fitted.height * 3);
+        CHECK(os.str().size() < fitted.width * fitted.height * 3 + 32);
+    }
+}
+
+TEST_CASE("Frame Statistics") {
+    FrameStats stats(100);
+    CHECK(stats.percentile(50) == 0);
+    for (int i = 1; i <= 300; ++i) { // Only the last 100 frames, 201..300, are kept
+        FrameSample sample;
+        sample.frame_ms = i;
+        sample.draw_calls = 4;
+        stats.record(sample);
+    }
+    CHECK(stats.frame_count() == 300);
+    CHECK(stats.last().frame_ms == 300);
+    CHECK(stats.percentile(0) == 201);
+    CHECK(stats.percentile(50) == 250);
+    CHECK(stats.percentile(95) == 295);
+    CHECK(stats.percentile(100) == 300);
+
+    CHECK_FALSE(stats.logging_enabled());
+    stats.start_log();
+    FrameSample sample;
+    sample.frame_ms = 16.5;
+    sample.vertices = 1200;
+    sample.nodes_culled = 7;
+    stats.record(sample);
+    stats.record(sample);
+    stats.stop_log();
+    stats.record(sample);
+    CHECK(stats.log_size() == 2);
+
+    ostringstream csv;
+    stats.write_csv(csv);
+    istringstream lines(csv.str());
+    string line;
+    getline(lines, line);
+    CHECK(line == "frame,frame_ms,layout_ms,bake_ms,draw_calls,vertices,nodes_drawn,nodes_collapsed,nodes_culled");
+    getline(lines, line);
+    CHECK(line == "0,16.5,0,0,0,1200,0,0,7");
+    getline(lines, line);
+    CHECK(line.compare(0, 2, "1,") == 0);
+    CHECK_FALSE(getline(lines, line));
+}
+
+template <typename T, int K>
+vector<size_t> child_histogram(const Tree<T, K>& tree) { // Number of nodes with 0, 1, ... K children
+    vector<size_t> histogram(K + 1, 0);
+    for (auto it = tree.begin_bfs_scan(); it != tree.end_bfs_scan(); ++it) {
+        ++histogram[(*it)->children.size()];
+    }
+    return histogram;
+}
+
+TEST_CASE("Workload Generator") {
+    WorkloadSpec spec;
+    spec.nodes = 1000;
+
+    SUBCASE("Shapes") {
+        spec.values = Values::Sequential;
+        spec.shape = Shape::Complete;
+        auto complete = generate_tree<double>(spec);
+        double expected = 0;
+        for (auto it = complete.begin_bfs_scan(); it != complete.end_bfs_scan(); ++it) {
+            CHECK((*it)->get_value() == expected++);
+        }
+        CHECK(expected == 1000);
+
+        spec.shape = Shape::DeepChain;
+        auto chain = generate_tree<double, 3>(spec);
+        CHECK(child_histogram(chain) == vector<size_t>{1, 999, 0, 0});
+
+        spec.shape = Shape::Caterpillar;
+        auto caterpillar = generate_tree<double, 3>(spec);
+        CHECK(child_histogram(caterpillar) == vector<size_t>{667, 0, 0, 333}); // Two legs and the next spine node each
+
+        for (Shape shape : {Shape::RandomRecursive, Shape::PreferentialAttachment}) {
+            spec.shape = shape;
+            auto binary = child_histogram(generate_tree<double>(spec));
+            CHECK(binary[0] + binary[1] + binary[2] == 1000);
+            CHECK(binary[1] + 2 * binary[2] == 999); // Every node but the root is somebody's child
+        }
+    }
+
+    SUBCASE("Preferential attachment grows hubs") {
+        spec.nodes = 10000;
+        spec.shape = Shape::RandomRecursive;
+        auto uniform = child_histogram(generate_tree<double, 10000>(spec));
+        spec.shape = Shape::PreferentialAttachment;
+        auto preferential = child_histogram(generate_tree<double, 10000>(spec));
+        size_t uniform_max = 0, preferential_max = 0;
+        for (size_t i = 0; i < uniform.size(); ++i) {
+            if (uniform[i]) uniform_max = i;
+            if (preferential[i]) preferential_max = i;
+        }
+        CHECK(uniform_max < 20); // About log2(n)
+        CHECK(preferential_max > 50); // About sqrt(n)
+    }
+
+    SUBCASE("Seeds and values") {
+        spec.shape = Shape::RandomRecursive;
+        auto values = [](const Tree<Complex>& tree) {
+            vector<Complex> result;
+            for (auto it = tree.begin_dfs_scan(); it != tree.end_dfs_scan(); ++it) result.push_back((*it)->get_value());
+            return result;
+        };
+        auto first = values(generate_tree<Complex>(spec));
+        CHECK(first == values(generate_tree<Complex>(spec)));
+        spec.seed = 2;
+        CHECK(first != values(generate_tree<Complex>(spec)));
+
+        spec.values = Values::Normal;
+        spec.low = 0;
+        spec.high = 60;
+        spec.nodes = 10000;
+        double sum = 0, squares = 0;
+        for (const Complex& value : values(generate_tree<Complex>(spec))) {
+            sum += value.getReal() + value.getImag();
+            squares += (value.getReal() - 30) * (value.getReal() - 30) + (value.getImag() - 30) * (value.getImag() - 30);
+        }
+        CHECK(sum / 20000 == doctest::Approx(30).epsilon(0.01));
+        CHECK(std::sqrt(squares / 20000) == doctest::Approx(10).epsilon(0.05));
+
+        spec.values = Values::Uniform;
+        spec.shape = Shape::Complete;
+        auto uniform = generate_tree<double>(spec);
+        for (auto it = uniform.begin_bfs_scan(); it != uniform.end_bfs_scan(); ++it) {
+            CHECK((*it)->get_value() >= 0);
+            CHECK((*it)->get_value() < 60);
+        }
+    }
+
+    SUBCASE("assign") {
+        Tree<double> tree;
+        tree.emplace_root(1.0);
+        size_t version = tree.version();
+        CHECK_THROWS(tree.assign(vector<size_t>{0, 1}, [](size_t) { return 0.0; })); // Child before its parent
+        CHECK_THROWS(tree.assign(vector<size_t>{0, 0, 0, 0}, [](size_t) { return 0.0; })); // Three children
+        CHECK(tree.version() == version);
+        CHECK(tree.get_root()->get_value() == 1.0);
+
+        tree.assign(vector<size_t>{0, 0, 1, 0}, [](size_t i) { return double(i); });
+        CHECK(tree.version() != version);
+        CHECK(tree.get_root()->children.size() == 2);
+        CHECK(tree.get_root()->children[1]->get_value() == 3.0);
+        CHECK(tree.get_root()->children[0]->children[0]->get_value() == 2.0);
+        CHECK(tree.emplace_child(tree.get_root()->children[1], 4.0)); // Still grows like any compacted tree
+
+        tree.assign(vector<size_t>(), [](size_t) { return 0.0; });
+        CHECK(tree.get_root() == nullptr);
+    }
+
+    SUBCASE("Contiguous blocks are freed") {
+        AllocationScope scope;
+        {
+            spec.shape = Shape::PreferentialAttachment;
+            auto tree = generate_tree<double>(spec);
+            tree.compact(Order::BFS); // Replaces the generated block
+            auto view = tree.snapshot();
+            auto leaf = tree.get_root();
+            while (!leaf->children.empty()) leaf = leaf->children.back();
+            CHECK(tree.emplace_child(leaf, 1.0)); // Copies the path out of the shared block
+            Tree<double> copy(view);
+            tree = generate_tree<double>(spec);
+        }
+        CHECK(scope.live() == 0);
+    }
+}
+
+TEST_CASE("Deep Trees") {
+    WorkloadSpec spec;
+    spec.nodes = 1000000; // Deep enough to overflow the stack one frame per level
+    spec.shape = Shape::DeepChain;
+
+    SUBCASE("Copies are freed without recursion") {
+        AllocationScope scope;
+        {
+            auto chain = generate_tree<double>(spec);
+            {
+                Tree<double> copy(chain); // One heap node per level
+                CHECK(copy.get_root()->children.size() == 1);
+            }
+            Tree<double> copy(chain);
+            copy = Tree<double>(); // Replaced by assignment
+            CHECK(copy.get_root() == nullptr);
+
+            copy = chain;
+            auto handle = copy.get_root();
+            copy = Tree<double>(); // The handle now holds the only reference to the chain
+            CHECK(handle.use_count() == 1);
+            handle.reset();
+        }
+        CHECK(scope.live() == 0);
+    }
+
+    SUBCASE("Replaced roots are freed without recursion") {
+        AllocationScope scope;
+        {
+            Tree<double> tree;
+            auto leaf = tree.emplace_root(0.0);
+            for (size_t i = 1; i < spec.nodes; ++i) leaf = tree.emplace_child(leaf, double(i));
+            leaf.reset();
+            tree.compact(Order::DFS); // Frees the heap chain it copied from
+            tree = generate_tree<double>(spec);
+            tree.emplace_root(0.0);
+        }
+        CHECK(scope.live() == 0);
+    }
+
+    SUBCASE("Searches do not recurse") {
+        spec.values = Values::Sequential; // The value of a node is its depth
+        auto chain = generate_tree<double>(spec);
+        auto leaf = chain.find_node(chain.get_root(), Node<double>(999999.0));
+        REQUIRE(leaf);
+        CHECK(leaf->children.empty());
+        CHECK_FALSE(chain.find_node(chain.get_root(), Node<double>(-1.0)));
+
+        auto view = chain.snapshot();
+        CHECK(chain.emplace_child(leaf, 1e6)); // Finds the path to copy it out of the snapshot
+        chain.add_sub_node(Node<double>(1e6), Node<double>(1e6 + 1));
+        CHECK(chain.remove_subtree(chain.find_node(chain.get_root(), Node<double>(500000.0))));
+        CHECK(chain.find_node(chain.get_root(), Node<double>(499999.0))->children.empty());
+        CHECK(view.find_node(view.get_root(), Node<double>(999999.0))->children.empty());
+    }
+}